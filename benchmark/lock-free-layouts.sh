@@ -0,0 +1,56 @@
+#!/bin/bash
+    
+# compare the entry layouts of the shared lock-free table (--lock_free_layout) on every distribution and thread count
+# 1. just clean && just build-cpp-release
+# 2. make sure datasets have been generated
+# 3. run this script from root of repository, with 2>&1 | tee <logfile>
+# or sbatch -p RM -N 1 -t 6:00:00 benchmark/lock-free-layouts.sh lock-free-layouts psc 128
+# logs are named with the algorithm as <algorithm>@<layout>, so extract.py keeps layouts apart
+
+ts=$(date "+%Y-%m-%d %H:%M:%S")
+exp_identifier=$1 # e.g. "dev0"
+machine_identifier=$2 # e.g. "psc"
+echo "Timestamp: $ts"
+echo "Script: lock-free-layouts.sh"
+echo "Comment: atomic vs bucket vs packed vs locked lock-free table entries"
+echo "Experiment Identifier: $exp_identifier"
+echo "machine Identifier: $machine_identifier"
+
+log_dir="logs/$exp_identifier/$machine_identifier"
+echo "We'll write outputs to $log_dir/"
+
+algorithms=('omp-lock-free-hash-table')
+lock_free_layouts=('atomic' 'bucket' 'packed' 'locked')
+
+distributions=('uniform' 'biuniform' 'exponential' 'normal')
+
+size_configs=('8M-2K' '8M-20K' '8M-200K' '8M-2M'    '80M-20K' '80M-200K' '80M-2M' '80M-20M')
+
+possible_np=(1 2 4 8 16 32 64 128)
+max_np=$3
+num_dryruns=3
+num_trials=5
+
+mkdir -p $log_dir
+
+# go on grid and run each experiment
+for dist in "${distributions[@]}"; do
+    for size_config in "${size_configs[@]}"; do
+        for algorithm in "${algorithms[@]}"; do
+            for lock_free_layout in "${lock_free_layouts[@]}"; do
+                for np in "${possible_np[@]}"; do
+                    if [[ $np -gt $max_np ]]; then
+                        continue
+                    fi
+                    exp_identifier="$dist,$size_config,$algorithm@$lock_free_layout,np$np"
+                    exp_log_path="$log_dir/$exp_identifier.log"
+                    echo "🧪 running $exp_identifier, will write to $exp_log_path"
+                    ./main --num_threads $np --algorithm $algorithm --lock_free_layout $lock_free_layout --dataset_file_path data/$dist/$size_config.csv.gz --num_dryruns $num_dryruns --num_trials $num_trials --validation_file_path data/$dist/val-$size_config.csv > $exp_log_path
+                    if [[ "$(grep "Validation passes" $exp_log_path)" != *"Validation passes"* ]]; then
+                        echo "🚨 Validation failed for $exp_identifier"
+                    fi
+                done
+            done
+        done
+    done
+done
@@ -0,0 +1,56 @@
+#!/bin/bash
+    
+# compare the local hash map backends of the two-phase algorithms (--map_backend) on every distribution
+# 1. just clean && just build-cpp-release
+# 2. make sure datasets have been generated
+# 3. run this script from root of repository, with 2>&1 | tee <logfile>
+# or sbatch -p RM -N 1 -t 6:00:00 benchmark/map-backends.sh map-backends psc 128
+# logs are named with the algorithm as <algorithm>@<backend>, so extract.py keeps backends apart
+
+ts=$(date "+%Y-%m-%d %H:%M:%S")
+exp_identifier=$1 # e.g. "dev0"
+machine_identifier=$2 # e.g. "psc"
+echo "Timestamp: $ts"
+echo "Script: map-backends.sh"
+echo "Comment: open-addressing vs swiss vs ska::flat_hash_map vs tsl::robin_map vs std::unordered_map local maps"
+echo "Experiment Identifier: $exp_identifier"
+echo "machine Identifier: $machine_identifier"
+
+log_dir="logs/$exp_identifier/$machine_identifier"
+echo "We'll write outputs to $log_dir/"
+
+algorithms=('two-phase-central-merge-xxhash' 'two-phase-tree-merge' 'two-phase-radix-xxhash')
+map_backends=('open-addressing' 'swiss' 'ska' 'robin' 'std')
+
+distributions=('uniform' 'biuniform' 'exponential' 'normal')
+
+size_configs=('8M-2K' '8M-20K' '8M-200K' '8M-2M'    '80M-20K' '80M-200K' '80M-2M' '80M-20M')
+
+possible_np=(1 2 4 8 16 32 64 128)
+max_np=$3
+num_dryruns=3
+num_trials=5
+
+mkdir -p $log_dir
+
+# go on grid and run each experiment
+for dist in "${distributions[@]}"; do
+    for size_config in "${size_configs[@]}"; do
+        for algorithm in "${algorithms[@]}"; do
+            for map_backend in "${map_backends[@]}"; do
+                for np in "${possible_np[@]}"; do
+                    if [[ $np -gt $max_np ]]; then
+                        continue
+                    fi
+                    exp_identifier="$dist,$size_config,$algorithm@$map_backend,np$np"
+                    exp_log_path="$log_dir/$exp_identifier.log"
+                    echo "🧪 running $exp_identifier, will write to $exp_log_path"
+                    ./main --num_threads $np --algorithm $algorithm --map_backend $map_backend --dataset_file_path data/$dist/$size_config.csv.gz --num_dryruns $num_dryruns --num_trials $num_trials --validation_file_path data/$dist/val-$size_config.csv > $exp_log_path
+                    if [[ "$(grep "Validation passes" $exp_log_path)" != *"Validation passes"* ]]; then
+                        echo "🚨 Validation failed for $exp_identifier"
+                    fi
+                done
+            done
+        done
+    done
+done
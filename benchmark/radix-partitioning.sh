@@ -0,0 +1,52 @@
+#!/bin/bash
+    
+# compare radix aggregating straight into per-partition maps with partitioning the rows first (swwc-radix) on the high cardinality configs
+# 1. just clean && just build-cpp-release
+# 2. make sure datasets have been generated
+# 3. run this script from root of repository, with 2>&1 | tee <logfile>
+# or sbatch -p RM -N 1 -t 6:00:00 benchmark/radix-partitioning.sh radix-partitioning psc 128
+
+ts=$(date "+%Y-%m-%d %H:%M:%S")
+exp_identifier=$1 # e.g. "dev0"
+machine_identifier=$2 # e.g. "psc"
+echo "Timestamp: $ts"
+echo "Script: radix-partitioning.sh"
+echo "Comment: two-phase-radix vs swwc-radix on high cardinality"
+echo "Experiment Identifier: $exp_identifier"
+echo "machine Identifier: $machine_identifier"
+
+log_dir="logs/$exp_identifier/$machine_identifier"
+echo "We'll write outputs to $log_dir/"
+
+algorithms=('two-phase-radix' 'swwc-radix')
+
+distributions=('uniform' 'biuniform' 'exponential' 'normal')
+
+size_configs=('8M-200K' '8M-2M' '80M-2M' '80M-20M' '800M-200M')
+
+possible_np=(1 2 4 8 16 32 64 128)
+max_np=$3
+num_dryruns=3
+num_trials=5
+
+mkdir -p $log_dir
+
+# go on grid and run each experiment
+for dist in "${distributions[@]}"; do
+    for size_config in "${size_configs[@]}"; do
+        for algorithm in "${algorithms[@]}"; do
+            for np in "${possible_np[@]}"; do
+                if [[ $np -gt $max_np ]]; then
+                    continue
+                fi
+                exp_identifier="$dist,$size_config,$algorithm,np$np"
+                exp_log_path="$log_dir/$exp_identifier.log"
+                echo "🧪 running $exp_identifier, will write to $exp_log_path"
+                ./main --num_threads $np --algorithm $algorithm --dataset_file_path data/$dist/$size_config.csv.gz --num_dryruns $num_dryruns --num_trials $num_trials --validation_file_path data/$dist/val-$size_config.csv > $exp_log_path
+                if [[ "$(grep "Validation passes" $exp_log_path)" != *"Validation passes"* ]]; then
+                    echo "🚨 Validation failed for $exp_identifier"
+                fi
+            done
+        done
+    done
+done
@@ -1,24 +1,30 @@
 //! one header to rule the algorithms all
 //! include any algorithm here with the same signature
+//! algorithms are templated on the table layout and instantiated for every layout in their own .cpp
 
 #pragma once
 
 #include "../lib.hpp"
 
-void sequential_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
-void global_lock_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
-void two_phase_centralised_merge_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
-void two_phase_tree_merge_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
-void two_phase_centralised_merge_xxhash_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
-void duckdbish_two_phase_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
-void implicit_repartitioning_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
-void three_phase_radix_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
-void two_phase_radix_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
-void two_phase_radix_xxhash_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
-void lock_free_hash_table_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
-void omp_lock_free_hash_table_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
-void adaptive_alg1_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
-void adaptive_alg2_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
-void adaptive_alg3_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
-void adaptive_alg4_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
+template <typename Table> void sequential_sol(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
+template <typename Table> void global_lock_sol(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
+template <typename Table> void two_phase_centralised_merge_sol(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
+template <typename Table> void two_phase_tree_merge_sol(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
+template <typename Table> void duckdbish_two_phase_sol(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
+template <typename Table> void implicit_repartitioning_sol(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
+template <typename Table> void delegation_sol(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
+template <typename Table> void three_phase_radix_sol(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
+template <typename Table> void two_phase_radix_sol(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
+template <typename Table> void swwc_radix_sol(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
+template <typename Table> void lock_free_hash_table_sol(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
+template <typename Table> void omp_lock_free_hash_table_sol(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
+template <typename Table> void partitioned_lock_free_hash_table_sol(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
+template <typename Table> void striped_lock_hash_table_sol(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
+template <typename Table> void optimistic_hash_table_sol(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
+template <typename Table> void adaptive_alg1_sol(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
+template <typename Table> void adaptive_alg2_sol(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
+template <typename Table> void adaptive_alg3_sol(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
+template <typename Table> void adaptive_alg4_sol(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
 
+// --streaming: reads the input itself batch by batch, so it takes no table
+void streaming_sol(ExpConfig &config, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res);
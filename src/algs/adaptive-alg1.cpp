@@ -14,7 +14,8 @@ enum class StratEnum {
 // phase 0: do sampling and decide on strategy
 // phase 1: each thread does local aggregation
 // phase 2: threads go merge
-void adaptive_alg1_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
+template <typename Hasher, typename Table>
+static void adaptive_alg1_impl(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
     omp_set_num_threads(config.num_threads);
 
     auto n_cols = table.n_cols;
@@ -38,12 +39,12 @@ void adaptive_alg1_sol(ExpConfig &config, RowStore &table, int trial_idx, bool d
     t_agg_0 = std::chrono::steady_clock::now();
     t_phase0_0 = std::chrono::steady_clock::now();
 
-    auto sample_phase_agg_map = XXHashAggMap();
-    auto hasher = I64Hasher{};
+    auto sample_phase_agg_map = AggMap<SkaMapBackend, Hasher>();
+    auto hasher = Hasher{};
     
     // === PHASE 0: do sampling ===
     
-    int n_sampled_row = std::min(sample_prefix_len, n_rows);
+    int64_t n_sampled_row = std::min<int64_t>(sample_prefix_len, n_rows);
     for (size_t r = 0; r < n_sampled_row; r++) {
         sample_phase_agg_map.accumulate_from_row(table, r);
     }
@@ -91,9 +92,9 @@ void adaptive_alg1_sol(ExpConfig &config, RowStore &table, int trial_idx, bool d
     
     if (strat_decision == StratEnum::CENTRAL) {
         // data structure if we were to do local hmap based things
-        auto local_agg_maps = std::vector<XXHashAggMap>(config.num_threads);
+        auto local_agg_maps = std::vector<AggMap<SkaMapBackend, Hasher>>(config.num_threads);
         assert(local_agg_maps.size() == config.num_threads);
-        XXHashAggMap agg_map; // where merged results go
+        AggMap<SkaMapBackend, Hasher> agg_map; // where merged results go
         // agg_map.reserve(G_hat_int);
         
         #pragma omp parallel
@@ -103,7 +104,7 @@ void adaptive_alg1_sol(ExpConfig &config, RowStore &table, int trial_idx, bool d
             assert(actual_num_threads == config.num_threads);
             
             // PHASE 1: local aggregation map
-            XXHashAggMap local_agg_map;
+            AggMap<SkaMapBackend, Hasher> local_agg_map;
             // local_agg_map.reserve(G_hat_int);
             
             if (tid == 0) { t_phase1_0 = std::chrono::steady_clock::now(); }
@@ -153,9 +154,9 @@ void adaptive_alg1_sol(ExpConfig &config, RowStore &table, int trial_idx, bool d
         
     } else if (strat_decision == StratEnum::TREE) {
         // data structure if we were to do local hmap based things
-        auto local_agg_maps = std::vector<XXHashAggMap>(config.num_threads);
+        auto local_agg_maps = std::vector<AggMap<SkaMapBackend, Hasher>>(config.num_threads);
         assert(local_agg_maps.size() == config.num_threads);
-        XXHashAggMap agg_map; // where merged results go        
+        AggMap<SkaMapBackend, Hasher> agg_map; // where merged results go        
         // agg_map.reserve(G_hat_int);
         
         #pragma omp parallel
@@ -165,7 +166,7 @@ void adaptive_alg1_sol(ExpConfig &config, RowStore &table, int trial_idx, bool d
             assert(actual_num_threads == config.num_threads);
             
             // PHASE 1: local aggregation map
-            XXHashAggMap local_agg_map;
+            AggMap<SkaMapBackend, Hasher> local_agg_map;
             // local_agg_map.reserve(G_hat_int);
             
             if (tid == 0) { t_phase1_0 = std::chrono::steady_clock::now(); }
@@ -217,7 +218,7 @@ void adaptive_alg1_sol(ExpConfig &config, RowStore &table, int trial_idx, bool d
     } else if (strat_decision == StratEnum::RADIX) {
         // if we were to do radix
         int n_partitions = config.num_threads * config.radix_partition_cnt_ratio;
-        std::vector<std::vector<XXHashAggMap>> radix_partitions_local_maps(n_partitions, std::vector<XXHashAggMap>(config.num_threads));    
+        std::vector<std::vector<OpenAddressingAggMap<Hasher>>> radix_partitions_local_maps(n_partitions, std::vector<OpenAddressingAggMap<Hasher>>(config.num_threads));    
 
         
         #pragma omp parallel
@@ -228,9 +229,9 @@ void adaptive_alg1_sol(ExpConfig &config, RowStore &table, int trial_idx, bool d
             
             // === PHASE 1: aggregate into partition and local aggregation map === 
             
-            std::vector<XXHashAggMap> local_radix_partitions(n_partitions);
+            std::vector<OpenAddressingAggMap<Hasher>> local_radix_partitions(n_partitions);
             for (size_t i = 0; i < n_partitions; i++) {
-                local_radix_partitions[i] = XXHashAggMap();
+                local_radix_partitions[i] = OpenAddressingAggMap<Hasher>();
                 // local_radix_partitions[i].reserve(G_hat_int);
             }
             
@@ -239,10 +240,10 @@ void adaptive_alg1_sol(ExpConfig &config, RowStore &table, int trial_idx, bool d
             #pragma omp for schedule(dynamic, config.batch_size)
             for (size_t r = 0; r < n_rows; r++) {
                 int64_t group_key = table.get(r, 0);
-                size_t group_key_hash = std::hash<int64_t>{}(group_key);
-                size_t part_idx = group_key_hash % n_partitions;
+                uint64_t group_key_hash = Hasher{}(group_key);
+                size_t part_idx = hash_partition(group_key_hash, n_partitions);
                 
-                local_radix_partitions[part_idx].accumulate_from_row(table, r);
+                local_radix_partitions[part_idx].accumulate_value(group_key_hash, group_key, table.get(r, 1));
             }
             for (size_t part_idx = 0; part_idx < n_partitions; part_idx++) {
                 radix_partitions_local_maps[part_idx][tid] = local_radix_partitions[part_idx];
@@ -298,42 +299,33 @@ void adaptive_alg1_sol(ExpConfig &config, RowStore &table, int trial_idx, bool d
     } else if (strat_decision == StratEnum::LOCKFREE) {
 
         t_agg_0 = std::chrono::steady_clock::now();
-        LockFreeAggMap map(static_cast<size_t>(G_hat) * 4);
+        // G_hat only sizes the table now, it grows past it if the prefix undercounted
+        GrowableLockFreeAggMap<Hasher> map(static_cast<size_t>(G_hat), config.num_threads);
 
-        bool htable_overflow = false;
-        
         #pragma omp parallel num_threads(config.num_threads)
         {
+            int tid = omp_get_thread_num();
             #pragma omp for schedule(static)
             for (size_t r = sample_prefix_len; r < n_rows; r++)
             {
-                bool succeeded = map.upsert(table.get(r, 0), table.get(r, 1));
-                if (!succeeded) {
-                    htable_overflow = true;
-                }
+                map.upsert(tid, table.get(r, 0), table.get(r, 1));
             }
         }
 
-        if (htable_overflow) {
-            std::cout << "un oh... blew up lock free htable... don't know what to do... fall back to two-phase-radix\n" << std::endl;
-            two_phase_radix_xxhash_sol(config, table, trial_idx, do_print_stats, agg_res);
-            return;
-        }
-
         for (auto& [key, val] : sample_phase_agg_map) {
-            map.accumulate_from_accval(key, val);
+            map.accumulate_from_accval(0, key, val);
         }
+        std::cout << "lock free htable grew " << map.n_migrations() << " times to capacity " << map.capacity() << std::endl;
 
         t_agg_1 = std::chrono::steady_clock::now();
         time_print("aggregation_time", trial_idx, t_agg_0, t_agg_1, do_print_stats);
 
         t_output_0 = std::chrono::steady_clock::now();
     
-        for (auto& entry : map.data)
+        map.for_each([&](const AggEntrySnapshot &entry)
         {
-            if (entry.key.load() == INT64_MIN) continue;
-            agg_res.push_back(AggResRow{entry.key.load(), entry.cnt.load(), entry.sum.load(), entry.min.load(), entry.max.load()});
-        }
+            agg_res.push_back(AggResRow{entry.key, entry.cnt, entry.sum, entry.min, entry.max});
+        });
     
         t_output_1 = std::chrono::steady_clock::now();
         time_print("write_output", trial_idx, t_output_0, t_output_1, do_print_stats);
@@ -361,3 +353,5 @@ void adaptive_alg1_sol(ExpConfig &config, RowStore &table, int trial_idx, bool d
     time_print("elapsed_time", trial_idx, t_overall_0, t_overall_1, do_print_stats);
 
 }
+
+DEFINE_HASHED_ALG_FOR_ALL_LAYOUTS(adaptive_alg1_sol, adaptive_alg1_impl<Hasher>);
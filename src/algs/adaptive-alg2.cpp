@@ -49,7 +49,8 @@ float radix_scan_cost_model(float G, int p_int, int num_partitions) {
 // phase 0: do sampling and decide on strategy
 // phase 1: each thread does local aggregation
 // phase 2: threads go merge
-void adaptive_alg2_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
+template <typename Hasher, typename Table>
+static void adaptive_alg2_impl(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
     omp_set_num_threads(config.num_threads);
 
     auto n_cols = table.n_cols;
@@ -68,16 +69,16 @@ void adaptive_alg2_sol(ExpConfig &config, RowStore &table, int trial_idx, bool d
     chrono_time_point t_output_0;
     chrono_time_point t_output_1;
     t_overall_0 = std::chrono::steady_clock::now();
-    auto hasher = I64Hasher{};
+    auto hasher = Hasher{};
     
     t_agg_0 = std::chrono::steady_clock::now();
     t_phase0_0 = std::chrono::steady_clock::now();
 
-    auto sample_phase_agg_map = XXHashAggMap();
+    auto sample_phase_agg_map = AggMap<SkaMapBackend, Hasher>();
     
     // === PHASE 0: do sampling ===
     
-    int n_sampled_row = std::min(sample_prefix_len, n_rows);
+    int64_t n_sampled_row = std::min<int64_t>(sample_prefix_len, n_rows);
     for (size_t r = 0; r < n_sampled_row; r++) {
         sample_phase_agg_map.accumulate_from_row(table, r);
     }
@@ -139,9 +140,9 @@ void adaptive_alg2_sol(ExpConfig &config, RowStore &table, int trial_idx, bool d
     
     if (strat_decision == StratEnum::CENTRAL) {
         // data structure if we were to do local hmap based things
-        auto local_agg_maps = std::vector<XXHashAggMap>(config.num_threads);
+        auto local_agg_maps = std::vector<AggMap<SkaMapBackend, Hasher>>(config.num_threads);
         assert(local_agg_maps.size() == config.num_threads);
-        XXHashAggMap agg_map; // where merged results go
+        AggMap<SkaMapBackend, Hasher> agg_map; // where merged results go
         // agg_map.reserve(G_hat_int);
         
         #pragma omp parallel
@@ -151,7 +152,7 @@ void adaptive_alg2_sol(ExpConfig &config, RowStore &table, int trial_idx, bool d
             assert(actual_num_threads == config.num_threads);
             
             // PHASE 1: local aggregation map
-            XXHashAggMap local_agg_map;
+            AggMap<SkaMapBackend, Hasher> local_agg_map;
             // local_agg_map.reserve(G_hat_int);
             
             if (tid == 0) { t_phase1_0 = std::chrono::steady_clock::now(); }
@@ -201,9 +202,9 @@ void adaptive_alg2_sol(ExpConfig &config, RowStore &table, int trial_idx, bool d
         
     } else if (strat_decision == StratEnum::TREE) {
         // data structure if we were to do local hmap based things
-        auto local_agg_maps = std::vector<XXHashAggMap>(config.num_threads);
+        auto local_agg_maps = std::vector<AggMap<SkaMapBackend, Hasher>>(config.num_threads);
         assert(local_agg_maps.size() == config.num_threads);
-        XXHashAggMap agg_map; // where merged results go        
+        AggMap<SkaMapBackend, Hasher> agg_map; // where merged results go        
         // agg_map.reserve(G_hat_int);
         
         #pragma omp parallel
@@ -213,7 +214,7 @@ void adaptive_alg2_sol(ExpConfig &config, RowStore &table, int trial_idx, bool d
             assert(actual_num_threads == config.num_threads);
             
             // PHASE 1: local aggregation map
-            XXHashAggMap local_agg_map;
+            AggMap<SkaMapBackend, Hasher> local_agg_map;
             // local_agg_map.reserve(G_hat_int);
             
             if (tid == 0) { t_phase1_0 = std::chrono::steady_clock::now(); }
@@ -265,7 +266,7 @@ void adaptive_alg2_sol(ExpConfig &config, RowStore &table, int trial_idx, bool d
     } else if (strat_decision == StratEnum::RADIX) {
         // if we were to do radix
         int n_partitions = config.num_threads * config.radix_partition_cnt_ratio;
-        std::vector<std::vector<XXHashAggMap>> radix_partitions_local_maps(n_partitions, std::vector<XXHashAggMap>(config.num_threads));    
+        std::vector<std::vector<OpenAddressingAggMap<Hasher>>> radix_partitions_local_maps(n_partitions, std::vector<OpenAddressingAggMap<Hasher>>(config.num_threads));    
 
         
         #pragma omp parallel
@@ -276,9 +277,9 @@ void adaptive_alg2_sol(ExpConfig &config, RowStore &table, int trial_idx, bool d
             
             // === PHASE 1: aggregate into partition and local aggregation map === 
             
-            std::vector<XXHashAggMap> local_radix_partitions(n_partitions);
+            std::vector<OpenAddressingAggMap<Hasher>> local_radix_partitions(n_partitions);
             for (size_t i = 0; i < n_partitions; i++) {
-                local_radix_partitions[i] = XXHashAggMap();
+                local_radix_partitions[i] = OpenAddressingAggMap<Hasher>();
                 // local_radix_partitions[i].reserve(G_hat_int);
             }
             
@@ -287,10 +288,10 @@ void adaptive_alg2_sol(ExpConfig &config, RowStore &table, int trial_idx, bool d
             #pragma omp for schedule(dynamic, config.batch_size)
             for (size_t r = 0; r < n_rows; r++) {
                 int64_t group_key = table.get(r, 0);
-                size_t group_key_hash = std::hash<int64_t>{}(group_key);
-                size_t part_idx = group_key_hash % n_partitions;
+                uint64_t group_key_hash = Hasher{}(group_key);
+                size_t part_idx = hash_partition(group_key_hash, n_partitions);
                 
-                local_radix_partitions[part_idx].accumulate_from_row(table, r);
+                local_radix_partitions[part_idx].accumulate_value(group_key_hash, group_key, table.get(r, 1));
             }
             for (size_t part_idx = 0; part_idx < n_partitions; part_idx++) {
                 radix_partitions_local_maps[part_idx][tid] = local_radix_partitions[part_idx];
@@ -366,3 +367,5 @@ void adaptive_alg2_sol(ExpConfig &config, RowStore &table, int trial_idx, bool d
     time_print("elapsed_time", trial_idx, t_overall_0, t_overall_1, do_print_stats);
 
 }
+
+DEFINE_HASHED_ALG_FOR_ALL_LAYOUTS(adaptive_alg2_sol, adaptive_alg2_impl<Hasher>);
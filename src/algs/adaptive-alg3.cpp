@@ -11,7 +11,7 @@ enum class StratEnum {
 };
 
 // estimate central merge cost if there are G keys, we have seen S rows, and we have p processors
-float central_merge_cost_model(float G, int S_int, int p_int) {
+float central_merge_cost_model(float G, int64_t S_int, int p_int) {
     float groups_per_thread = static_cast<float>(S_int);
     float p = static_cast<float>(p_int);
     return 
@@ -21,7 +21,7 @@ float central_merge_cost_model(float G, int S_int, int p_int) {
 }
 
 // estimate tree merge cost if there are G keys, we have seen S rows, and we have p processors
-float tree_merge_cost_model(float G, int S_int, int p_int) {
+float tree_merge_cost_model(float G, int64_t S_int, int p_int) {
     float groups_per_thread = static_cast<float>(S_int);
     const float lambda = 1.1f;
     float p = static_cast<float>(p_int);
@@ -43,7 +43,7 @@ float tree_merge_cost_model(float G, int S_int, int p_int) {
 }
 
 // estimate radix merge cost if there are G keys, we have seen S rows, and we have p processors
-float radix_merge_cost_model(float G, int S_int, int p_int) {
+float radix_merge_cost_model(float G, int64_t S_int, int p_int) {
     float groups_per_thread = static_cast<float>(S_int);
     float p = static_cast<float>(p_int);
     return 
@@ -52,18 +52,19 @@ float radix_merge_cost_model(float G, int S_int, int p_int) {
         (1.0f / p);
 }
 
-float noradix_scan_cost_model(float G, int S_int, int p_int) {
+float noradix_scan_cost_model(float G, int64_t S_int, int p_int) {
     float groups_per_thread = static_cast<float>(S_int);
     return 1.0f * groups_per_thread + G * log2(G);
 }
 
-float radix_scan_cost_model(float G, int S_int, int p_int, int num_partitions) {
+float radix_scan_cost_model(float G, int64_t S_int, int p_int, int num_partitions) {
     float groups_per_thread = static_cast<float>(S_int);
     float N = static_cast<float>(num_partitions);
     return 2.0f * groups_per_thread + G * log2(G / N);
 }
 
-void adaptive_alg3_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
+template <typename Hasher, typename Table>
+static void adaptive_alg3_impl(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
 
     auto n_cols = table.n_cols;
     auto n_rows = table.n_rows;
@@ -78,7 +79,7 @@ void adaptive_alg3_sol(ExpConfig &config, RowStore &table, int trial_idx, bool d
     t_agg_0 = std::chrono::steady_clock::now();
     
     int B = config.batch_size;
-    int S = B;
+    int64_t S = B;
     int p = config.num_threads;
     int p_hat = std::min(4, p);
     int adaptation_step = 0;
@@ -91,28 +92,28 @@ void adaptive_alg3_sol(ExpConfig &config, RowStore &table, int trial_idx, bool d
     bool touched_lock_free = false;
     
     // data structure if we were to do local hmap based things
-    auto local_agg_maps = std::vector<XXHashAggMap>(config.num_threads);
+    auto local_agg_maps = std::vector<AggMap<SkaMapBackend, Hasher>>(config.num_threads);
     assert(local_agg_maps.size() == config.num_threads);
-    XXHashAggMap local_agg_maps_merged; // where merged results go
+    AggMap<SkaMapBackend, Hasher> local_agg_maps_merged; // where merged results go
     
     // if we were to do radix
     int n_partitions = config.num_threads * config.radix_partition_cnt_ratio;
-    std::vector<std::vector<XXHashAggMap>> radix_partitions_local_maps(n_partitions, std::vector<XXHashAggMap>(config.num_threads));    
-    auto hasher = I64Hasher{};
+    std::vector<std::vector<OpenAddressingAggMap<Hasher>>> radix_partitions_local_maps(n_partitions, std::vector<OpenAddressingAggMap<Hasher>>(config.num_threads));    
+    auto hasher = Hasher{};
     
-    // if we do lock free hash table later... for now, size = 0
-    LockFreeAggMap lock_free_map(0);
+    // if we do lock free hash table later... for now, minimum size, it grows as keys come in
+    GrowableLockFreeAggMap<Hasher> lock_free_map(0, config.num_threads);
     
     
     // === interatively process larger and larger number of rows
-    int row_lb = 0;
-    int row_ub = S;
+    int64_t row_lb = 0;
+    int64_t row_ub = S;
 
     // G sampling
     int g_tilde_sum = 0;
-    int n_sampled_row = 0;
+    int64_t n_sampled_row = 0;
     float max_G_hat = 1.0f;
-    ska::flat_hash_map<int64_t, int64_t, I64Hasher> g_sample_map;
+    ska::flat_hash_map<int64_t, int64_t, Hasher> g_sample_map;
     
     do {
         std::cout << "adaptation_step = " << adaptation_step << std::endl;
@@ -139,12 +140,11 @@ void adaptive_alg3_sol(ExpConfig &config, RowStore &table, int trial_idx, bool d
                     local_agg_maps[tid].accumulate_from_row(table, r);
                 } else if (a_hat == StratEnum::RADIX) {
                     int64_t group_key = table.get(r, 0);
-                    size_t group_key_hash = std::hash<int64_t>{}(group_key);
-                    size_t part_idx = group_key_hash % n_partitions;
-                    radix_partitions_local_maps[part_idx][tid].accumulate_from_row(table, r);
+                    uint64_t group_key_hash = Hasher{}(group_key);
+                    size_t part_idx = hash_partition(group_key_hash, n_partitions);
+                    radix_partitions_local_maps[part_idx][tid].accumulate_value(group_key_hash, group_key, table.get(r, 1));
                 } else if (a_hat == StratEnum::LOCKFREE) {
-                    bool succeeded = lock_free_map.upsert(table.get(r, 0), table.get(r, 1));
-                    assert(succeeded);
+                    lock_free_map.upsert(tid, table.get(r, 0), table.get(r, 1));
                 } else {
                     throw std::runtime_error("unreachable");
                 }
@@ -188,22 +188,8 @@ void adaptive_alg3_sol(ExpConfig &config, RowStore &table, int trial_idx, bool d
             std::cout << ">> adaption-step=" << adaptation_step << ", adapt-to=lock-free" << std::endl;
             a_hat = StratEnum::LOCKFREE;
             p_hat = p;
-            int want_lock_free_map_size = G_hat_int * 12;
-            int acceptable_lock_free_map_size = G_hat_int * 4;
-
-            std::cout << "want_lock_free_map_size" << want_lock_free_map_size << std::endl;
-            std::cout << "acceptable_lock_free_map_size" << acceptable_lock_free_map_size << std::endl;
-            
-            if (lock_free_map.size < acceptable_lock_free_map_size && (!touched_lock_free)) {
-                std::cout << "resizing lock free hmap" << std::endl;
-                // resize it to want_lock_free_map_size
-                LockFreeAggMap new_lock_free_map(want_lock_free_map_size);
-                for (auto& entry : lock_free_map.data) {
-                    if (entry.key.load() == INT64_MIN) { continue; }
-                    new_lock_free_map.accumulate_from_accval_elems(entry.key.load(), entry.cnt.load(), entry.sum.load(), entry.min.load(), entry.max.load());
-                }
-                lock_free_map = std::move(new_lock_free_map);
-            }
+            // grow to the estimate before the scan (max_G_hat can overshoot, never past n_rows), all threads help move what is in there already
+            lock_free_map.reserve(std::min<int64_t>(G_hat_int, n_rows));
             
             touched_lock_free = true;
         } else {
@@ -320,20 +306,18 @@ void adaptive_alg3_sol(ExpConfig &config, RowStore &table, int trial_idx, bool d
                 #pragma omp for schedule(dynamic, 1)
                 for (size_t part_idx = 0; part_idx < n_partitions; part_idx++) {
                     for (auto& [key, val] : radix_partitions_local_maps[part_idx][0]) {
-                        bool succeeded = lock_free_map.accumulate_from_accval(key, val);
-                        assert(succeeded);
+                        lock_free_map.accumulate_from_accval(omp_get_thread_num(), key, val);
                     }
                 }
             }
         }
         if (touched_per_therad_maps) {
             for (auto& [key, val] : local_agg_maps[0]) {
-                bool succeeded = lock_free_map.accumulate_from_accval(key, val);
-                assert(succeeded);
+                lock_free_map.accumulate_from_accval(0, key, val);
             }
         }
         
-        std::cout << "results are in lock free hash table with max size " << lock_free_map.size << std::endl; 
+        std::cout << "results are in lock free hash table with capacity " << lock_free_map.capacity() << " after " << lock_free_map.n_migrations() << " migrations" << std::endl; 
 
     } else if (touched_radix) {
         if (touched_per_therad_maps) {
@@ -341,9 +325,9 @@ void adaptive_alg3_sol(ExpConfig &config, RowStore &table, int trial_idx, bool d
             
             // merge thread local into radix and done
             for (const auto& [group_key, other_agg_acc] : local_agg_maps[0]) {
-                size_t group_key_hash = std::hash<int64_t>{}(group_key);
-                size_t part_idx = group_key_hash % n_partitions;
-                radix_partitions_local_maps[part_idx][0].accumulate_from_agg_acc(group_key, other_agg_acc);
+                uint64_t group_key_hash = Hasher{}(group_key);
+                size_t part_idx = hash_partition(group_key_hash, n_partitions);
+                radix_partitions_local_maps[part_idx][0].accumulate_from_agg_acc(group_key_hash, group_key, other_agg_acc);
             }
         }
         std::cout << "result in all radix_partitions_local_maps[any part_idx][0]" << std::endl; 
@@ -354,10 +338,9 @@ void adaptive_alg3_sol(ExpConfig &config, RowStore &table, int trial_idx, bool d
     }
     
     if (touched_lock_free) {
-        for (auto& entry : lock_free_map.data) {
-            if (entry.key.load() == INT64_MIN) continue;
-            agg_res.push_back(AggResRow{entry.key.load(), entry.cnt.load(), entry.sum.load(), entry.min.load(), entry.max.load()});
-        }
+        lock_free_map.for_each([&](const AggEntrySnapshot &entry) {
+            agg_res.push_back(AggResRow{entry.key, entry.cnt, entry.sum, entry.min, entry.max});
+        });
     } else if (touched_radix) {
         for (size_t part_idx = 0; part_idx < n_partitions; part_idx++) {
             for (auto& [group_key, agg_acc] : radix_partitions_local_maps[part_idx][0]) {
@@ -376,3 +359,5 @@ void adaptive_alg3_sol(ExpConfig &config, RowStore &table, int trial_idx, bool d
     t_overall_1 = std::chrono::steady_clock::now();
     time_print("elapsed_time", trial_idx, t_overall_0, t_overall_1, do_print_stats);
 }
+
+DEFINE_HASHED_ALG_FOR_ALL_LAYOUTS(adaptive_alg3_sol, adaptive_alg3_impl<Hasher>);
@@ -0,0 +1,146 @@
+// approach: threads scan disjoint morsels and hand every row to the thread owning its hash partition (one
+// partition per thread), through a single producer single consumer ring for every (sender, owner) pair.
+// owners aggregate into private maps, so there are no atomics on the groups and no merge phase, and unlike
+// implicit-repartitioning every row is read once
+
+#include "../lib.hpp"
+
+#include <memory>
+
+struct DelegatedRow {
+    uint64_t hash; // hashed once by the sender, the owner's map reuses it
+    int64_t key;
+    int64_t val;
+};
+
+// rows for each owner are staged and pushed DELEGATION_BATCH at a time, a ring holds 8 batches
+const int DELEGATION_BATCH = 32;
+typedef SpscRing<DelegatedRow, 8 * DELEGATION_BATCH> DelegationRing;
+
+template <typename AggMap, typename Table>
+static void delegation_impl(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
+    omp_set_num_threads(config.num_threads);
+
+    auto n_rows = table.n_rows;
+    int num_threads = config.num_threads;
+
+    chrono_time_point t_overall_0;
+    chrono_time_point t_overall_1;
+    chrono_time_point t_agg_0;
+    chrono_time_point t_agg_1;
+    chrono_time_point t_output_0;
+    chrono_time_point t_output_1;
+    t_overall_0 = std::chrono::steady_clock::now();
+
+
+
+    t_agg_0 = std::chrono::steady_clock::now();
+    auto owner_agg_maps = std::vector<AggMap>(num_threads);
+    // rings[sender * num_threads + owner]
+    std::unique_ptr<DelegationRing[]> rings(new DelegationRing[num_threads * num_threads]);
+    std::atomic<int> n_senders_done{0};
+    int64_t n_stalls = 0; // pushes that found the ring full
+
+    #pragma omp parallel reduction(+: n_stalls)
+    {
+        int tid = omp_get_thread_num();
+        int actual_num_threads = omp_get_num_threads();
+        assert(actual_num_threads == num_threads);
+
+        AggMap local_agg_map;
+
+        auto drain = [&]() {
+            size_t n_drained = 0;
+            for (int sender = 0; sender < num_threads; sender++) {
+                n_drained += rings[sender * num_threads + tid].pop_all([&](const DelegatedRow &row) {
+                    local_agg_map.accumulate_value(row.hash, row.key, row.val);
+                });
+            }
+            return n_drained;
+        };
+
+        std::vector<std::array<DelegatedRow, DELEGATION_BATCH>> staged(num_threads);
+        std::vector<int> n_staged(num_threads, 0);
+        // a full ring means its owner is behind, drain our own rings meanwhile so two senders never wait on each other
+        auto flush = [&](int owner) {
+            while (!rings[tid * num_threads + owner].try_push(staged[owner].data(), n_staged[owner])) {
+                n_stalls++;
+                if (drain() == 0) {
+                    std::this_thread::yield();
+                }
+            }
+            n_staged[owner] = 0;
+        };
+
+        #pragma omp for schedule(dynamic, 1) nowait
+        for (int64_t batch_lb = 0; batch_lb < n_rows; batch_lb += config.batch_size) {
+            int64_t batch_ub = std::min<int64_t>(batch_lb + config.batch_size, n_rows);
+            for (int64_t r = batch_lb; r < batch_ub; r++) {
+                int64_t group_key = table.get(r, 0);
+                uint64_t group_key_hash = typename AggMap::hasher{}(group_key);
+                int owner = hash_partition(group_key_hash, num_threads);
+                if (owner == tid) {
+                    local_agg_map.accumulate_value(group_key_hash, group_key, table.get(r, 1));
+                    continue;
+                }
+                staged[owner][n_staged[owner]++] = DelegatedRow{group_key_hash, group_key, table.get(r, 1)};
+                if (n_staged[owner] == DELEGATION_BATCH) {
+                    flush(owner);
+                }
+            }
+            drain();
+        }
+        for (int owner = 0; owner < num_threads; owner++) {
+            if (n_staged[owner] > 0) {
+                flush(owner);
+            }
+        }
+        n_senders_done.fetch_add(1, std::memory_order_release);
+
+        // every push happens before its sender counts itself done, so once all are done one empty drain means we have it all
+        while (true) {
+            bool all_senders_done = n_senders_done.load(std::memory_order_acquire) == num_threads;
+            size_t n_drained = drain();
+            if (all_senders_done && n_drained == 0) {
+                break;
+            }
+            if (n_drained == 0) {
+                std::this_thread::yield();
+            }
+        }
+        owner_agg_maps[tid] = std::move(local_agg_map);
+    }
+
+    t_agg_1 = std::chrono::steady_clock::now();
+    time_print("aggregation_time", trial_idx, t_agg_0, t_agg_1, do_print_stats);
+    if (do_print_stats) {
+        std::cout << ">>> run=" << trial_idx << ", delegation_stalls=" << n_stalls << std::endl;
+    }
+
+
+
+    // write output to vector, owners have disjoint groups
+    {
+        t_output_0 = std::chrono::steady_clock::now();
+        for (int owner = 0; owner < num_threads; owner++) {
+            for (auto& [group_key, agg_acc] : owner_agg_maps[owner]) {
+                agg_res.push_back(AggResRow{group_key, agg_acc[0], agg_acc[1], agg_acc[2], agg_acc[3]});
+            }
+        }
+        t_output_1 = std::chrono::steady_clock::now();
+        time_print("write_output", trial_idx, t_output_0, t_output_1, do_print_stats);
+    }
+
+    t_overall_1 = std::chrono::steady_clock::now();
+    time_print("elapsed_time", trial_idx, t_overall_0, t_overall_1, do_print_stats);
+}
+
+// the owners' map type comes from --map_backend (open addressing by default)
+template <typename Table>
+void delegation_sol(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
+    with_agg_map_backend(config, [&](auto map) {
+        delegation_impl<decltype(map)>(config, table, trial_idx, do_print_stats, agg_res);
+    });
+}
+
+INSTANTIATE_ALG_FOR_ALL_LAYOUTS(delegation_sol);
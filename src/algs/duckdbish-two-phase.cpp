@@ -2,7 +2,8 @@
 
 #include "../lib.hpp"
 
-void duckdbish_two_phase_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
+template <typename Hasher, typename Table>
+static void duckdbish_two_phase_impl(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
     omp_set_num_threads(config.num_threads);
     
     auto n_cols = table.n_cols;
@@ -25,12 +26,14 @@ void duckdbish_two_phase_sol(ExpConfig &config, RowStore &table, int trial_idx,
     t_agg_0 = std::chrono::steady_clock::now();
     int n_partitions = config.num_threads * config.radix_partition_cnt_ratio;
     
-    // radix_partitions being a size n_thread array of n_thread array of local agg maps
-    std::vector<std::vector<XXHashAggMap>> radix_partitions_local_maps(n_partitions, std::vector<XXHashAggMap>(config.num_threads));
-    // radix_partitions[2][3] is thread 3's result for partition 2
-    auto local_agg_maps = std::vector<XXHashAggMap>(config.num_threads);
+    std::vector<std::vector<AggPayload>> radix_partitions_payloads(n_partitions, std::vector<AggPayload>(config.num_threads));
+    // radix_partitions_payloads[2][3] is thread 3's entries for partition 2, with their hashes
+    std::vector<PayloadAggMap<Hasher>> partition_agg_maps(n_partitions);
+    // splits partitions much larger than the average in the merge phase
+    RadixMergePlan<PayloadAggMap<Hasher>> merge_plan;
+    auto local_agg_maps = std::vector<PayloadAggMap<Hasher>>(config.num_threads);
     assert(local_agg_maps.size() == config.num_threads);
-    XXHashAggMap agg_map; // where merged results go if we don't end up partitioning
+    PayloadAggMap<Hasher> agg_map; // where merged results go if we don't end up partitioning
 
     std::cout << "n_partitions = " << n_partitions << std::endl;
     std::cout << "done initialising all the partitions" << std::endl;
@@ -48,7 +51,7 @@ void duckdbish_two_phase_sol(ExpConfig &config, RowStore &table, int trial_idx,
         
         // === PHASE 1: local aggregation map === 
         
-        XXHashAggMap local_agg_map;
+        PayloadAggMap<Hasher> local_agg_map;
         
         if (tid == 0) { t_phase1_0 = std::chrono::steady_clock::now(); }
         
@@ -65,24 +68,16 @@ void duckdbish_two_phase_sol(ExpConfig &config, RowStore &table, int trial_idx,
                 do_partition = true;
             }
             // do partition early
-            for (auto& [group_key, agg_acc] : local_agg_map) {
-                size_t group_key_hash = std::hash<int64_t>{}(group_key);
-                size_t part_idx = group_key_hash % n_partitions;
-                radix_partitions_local_maps[part_idx][tid][group_key] = agg_acc;
-            }
+            local_agg_map.scatter_to_partitions(radix_partitions_payloads, tid);
             local_done_partition = true;
         }
         #pragma omp barrier
         if (do_partition && !local_done_partition) { 
             // some thread told global to partition, but we haven't done so
-            for (auto& [group_key, agg_acc] : local_agg_map) {
-                size_t group_key_hash = std::hash<int64_t>{}(group_key);
-                size_t part_idx = group_key_hash % n_partitions;
-                radix_partitions_local_maps[part_idx][tid][group_key] = agg_acc;
-            }
+            local_agg_map.scatter_to_partitions(radix_partitions_payloads, tid);
         }
         if (!do_partition) {
-            local_agg_maps[tid] = local_agg_map;
+            local_agg_maps[tid] = std::move(local_agg_map);
         }
         #pragma omp barrier
         if (tid == 0) {
@@ -97,11 +92,33 @@ void duckdbish_two_phase_sol(ExpConfig &config, RowStore &table, int trial_idx,
         if (tid == 0) { t_phase2_0 = std::chrono::steady_clock::now(); }
         
         if (do_partition) {        
+            #pragma omp single
+            {
+                std::vector<size_t> partition_sizes(n_partitions, 0);
+                for (int part_idx = 0; part_idx < n_partitions; part_idx++) {
+                    for (auto &payload : radix_partitions_payloads[part_idx]) {
+                        partition_sizes[part_idx] += payload.size();
+                    }
+                }
+                merge_plan.plan(partition_sizes, actual_num_threads);
+            }
+
             #pragma omp for schedule(dynamic, 1)
-            for (size_t part_idx = 0; part_idx < n_partitions; part_idx++) {
-                for (size_t other_tid = 1; other_tid < actual_num_threads; other_tid++) {
-                    auto other_local_agg_map = radix_partitions_local_maps[part_idx][other_tid];
-                    radix_partitions_local_maps[part_idx][0].merge_from(other_local_agg_map);
+            for (size_t task_idx = 0; task_idx < merge_plan.n_scatter_tasks(); task_idx++) {
+                auto task = merge_plan.scatter_task(task_idx);
+                merge_plan.scatter(task.part_idx, task.idx, radix_partitions_payloads[task.part_idx][task.idx]);
+            }
+
+            #pragma omp for schedule(dynamic, 1)
+            for (size_t task_idx = 0; task_idx < merge_plan.n_merge_tasks(); task_idx++) {
+                size_t part_idx = merge_plan.merge_task(task_idx).part_idx;
+                if (merge_plan.is_split(part_idx)) {
+                    merge_plan.merge_piece(part_idx, merge_plan.merge_task(task_idx).idx);
+                    continue;
+                }
+                // merging reuses the hashes stored with each entry
+                for (size_t other_tid = 0; other_tid < actual_num_threads; other_tid++) {
+                    partition_agg_maps[part_idx].merge_from(radix_partitions_payloads[part_idx][other_tid]);
                 }
             }
         } else {
@@ -109,8 +126,7 @@ void duckdbish_two_phase_sol(ExpConfig &config, RowStore &table, int trial_idx,
                 agg_map = std::move(local_agg_maps[0]);
                 
                 for (int other_tid = 1; other_tid < actual_num_threads; other_tid++) {
-                    auto other_local_agg_map = local_agg_maps[other_tid];
-                    agg_map.merge_from(other_local_agg_map);
+                    agg_map.merge_from(local_agg_maps[other_tid]);
                 }    
             }
         }
@@ -118,6 +134,9 @@ void duckdbish_two_phase_sol(ExpConfig &config, RowStore &table, int trial_idx,
         if (tid == 0) {
             t_phase2_1 = std::chrono::steady_clock::now();
             time_print("phase_2", trial_idx, t_phase2_0, t_phase2_1, do_print_stats);
+            if (do_partition) {
+                merge_plan.stats_print(trial_idx, do_print_stats);
+            }
         }
 
     }
@@ -131,8 +150,15 @@ void duckdbish_two_phase_sol(ExpConfig &config, RowStore &table, int trial_idx,
         
         if (do_partition) {
             for (size_t part_idx = 0; part_idx < n_partitions; part_idx++) {
-                // agg_map.merge(radix_partitions_local_maps[part_idx][0]);
-                for (auto& [group_key, agg_acc] : radix_partitions_local_maps[part_idx][0]) {
+                if (merge_plan.is_split(part_idx)) {
+                    for (auto &piece_map : merge_plan.pieces(part_idx)) {
+                        for (auto& [group_key, agg_acc] : piece_map) {
+                            agg_res.push_back(AggResRow{group_key, agg_acc[0], agg_acc[1], agg_acc[2], agg_acc[3]});
+                        }
+                    }
+                    continue;
+                }
+                for (auto& [group_key, agg_acc] : partition_agg_maps[part_idx]) {
                     agg_res.push_back(AggResRow{group_key, agg_acc[0], agg_acc[1], agg_acc[2], agg_acc[3]});
                 }
             }
@@ -149,3 +175,5 @@ void duckdbish_two_phase_sol(ExpConfig &config, RowStore &table, int trial_idx,
     t_overall_1 = std::chrono::steady_clock::now();
     time_print("elapsed_time", trial_idx, t_overall_0, t_overall_1, do_print_stats);
 }
+
+DEFINE_HASHED_ALG_FOR_ALL_LAYOUTS(duckdbish_two_phase_sol, duckdbish_two_phase_impl<Hasher>);
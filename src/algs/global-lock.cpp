@@ -2,7 +2,8 @@
 
 #include "../lib.hpp"
 
-void global_lock_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
+template <typename Hasher, typename Table>
+static void global_lock_impl(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
     omp_set_num_threads(config.num_threads);
     
     auto n_cols = table.n_cols;
@@ -19,7 +20,7 @@ void global_lock_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_
     
     
     t_agg_0 = std::chrono::steady_clock::now();
-    SimpleHashAggMap agg_map;
+    AggMap<StdMapBackend, Hasher> agg_map;
     
     #pragma omp parallel
     {
@@ -56,3 +57,5 @@ void global_lock_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_
     
     time_print("elapsed_time", trial_idx, t_overall_0, t_overall_1, do_print_stats);
 }
+
+DEFINE_HASHED_ALG_FOR_ALL_LAYOUTS(global_lock_sol, global_lock_impl<Hasher>);
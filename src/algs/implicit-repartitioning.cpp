@@ -3,7 +3,8 @@
 
 #include "../lib.hpp"
 
-void implicit_repartitioning_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
+template <typename Hasher, typename Table>
+static void implicit_repartitioning_impl(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
     omp_set_num_threads(config.num_threads);
     
     auto n_cols = table.n_cols;
@@ -20,7 +21,7 @@ void implicit_repartitioning_sol(ExpConfig &config, RowStore &table, int trial_i
     
     
     t_agg_0 = std::chrono::steady_clock::now();
-    auto local_agg_maps = std::vector<SimpleHashAggMap>(config.num_threads);
+    auto local_agg_maps = std::vector<AggMap<StdMapBackend, Hasher>>(config.num_threads);
     assert(local_agg_maps.size() == config.num_threads);
     
     #pragma omp parallel
@@ -29,16 +30,16 @@ void implicit_repartitioning_sol(ExpConfig &config, RowStore &table, int trial_i
         int actual_num_threads = omp_get_num_threads();
         assert(actual_num_threads == config.num_threads);
         
-        SimpleHashAggMap local_agg_map;
+        AggMap<StdMapBackend, Hasher> local_agg_map;
         
         for (size_t r = 0; r < n_rows; r++) {
             auto group_key = table.get(r, 0);
             
-            size_t group_key_hash = std::hash<int64_t>{}(group_key);
-            size_t part_idx = group_key_hash % config.num_threads;
+            uint64_t group_key_hash = Hasher{}(group_key);
+            size_t part_idx = hash_partition(group_key_hash, config.num_threads);
             if (part_idx != tid) { continue; }
             
-            local_agg_map.accumulate_from_row(table, r);
+            local_agg_map.accumulate_value(group_key_hash, group_key, table.get(r, 1));
         }
         local_agg_maps[tid] = local_agg_map;
         
@@ -67,3 +68,4 @@ void implicit_repartitioning_sol(ExpConfig &config, RowStore &table, int trial_i
 
 }
 
+DEFINE_HASHED_ALG_FOR_ALL_LAYOUTS(implicit_repartitioning_sol, implicit_repartitioning_impl<Hasher>);
@@ -13,7 +13,8 @@
 
 #include "../lib.hpp"
 
-void lock_free_hash_table_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res)
+template <typename LockFreeMap, typename Table>
+static void lock_free_hash_table_impl(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res)
 {
     chrono_time_point t_overall_0;
     chrono_time_point t_overall_1;
@@ -27,10 +28,14 @@ void lock_free_hash_table_sol(ExpConfig &config, RowStore &table, int trial_idx,
     t_aggregate_0 = std::chrono::steady_clock::now();
 
     auto n_rows = table.n_rows;
-    LockFreeAggMap map(n_rows);
-
     int num_threads = config.num_threads;
 
+    // sized from a sampled group count instead of n_rows, it grows if the guess is low
+    LockFreeMap map(sample_group_count(table), num_threads);
+    // with --heavy_hitters, rows of very frequent keys skip the shared table
+    HeavyHitterLayer heavy_hitters(num_threads);
+    bool use_heavy_hitters = config.heavy_hitters;
+
     std::vector<std::thread> threads;
 
     for (int t = 0; t < num_threads; ++t)
@@ -38,8 +43,14 @@ void lock_free_hash_table_sol(ExpConfig &config, RowStore &table, int trial_idx,
         threads.emplace_back([&, t]() {
             for (size_t r = t; r < n_rows; r += num_threads)
             {
-                map.upsert(table.get(r, 0), table.get(r, 1));
+                int64_t key = table.get(r, 0);
+                int64_t val = table.get(r, 1);
+                if (use_heavy_hitters && heavy_hitters.accumulate(t, key, val)) continue;
+                map.upsert(t, key, val);
             }
+            heavy_hitters.for_each_hot(t, [&](int64_t key, const AggMapValue &acc) {
+                map.accumulate_from_accval(t, key, acc);
+            });
         });
     }
 
@@ -50,13 +61,19 @@ void lock_free_hash_table_sol(ExpConfig &config, RowStore &table, int trial_idx,
 
     t_aggregate_1 = std::chrono::steady_clock::now();
     time_print("aggregation_time", trial_idx, t_aggregate_0, t_aggregate_1, do_print_stats);
+    if (use_heavy_hitters) {
+        heavy_hitters.stats_print(trial_idx, do_print_stats);
+    }
 
     t_output_0 = std::chrono::steady_clock::now();
 
-    for (auto& entry : map.data)
+    map.for_each([&](const AggEntrySnapshot &entry)
     {
-        if (entry.key.load() == INT64_MIN) continue;
-        agg_res.push_back(AggResRow{entry.key.load(), entry.cnt.load(), entry.sum.load(), entry.min.load(), entry.max.load()});
+        agg_res.push_back(AggResRow{entry.key, entry.cnt, entry.sum, entry.min, entry.max});
+    });
+    if (do_print_stats) {
+        std::cout << ">>> run=" << trial_idx << ", lock_free_migrations=" << map.n_migrations() << std::endl;
+        std::cout << ">>> run=" << trial_idx << ", lock_free_capacity=" << map.capacity() << std::endl;
     }
 
     t_output_1 = std::chrono::steady_clock::now();
@@ -65,3 +82,13 @@ void lock_free_hash_table_sol(ExpConfig &config, RowStore &table, int trial_idx,
     t_overall_1 = std::chrono::steady_clock::now();
     time_print("elapsed_time", trial_idx, t_overall_0, t_overall_1, do_print_stats);
 }
+
+// the entry layout comes from --lock_free_layout (atomic by default), the hash function from --hash
+template <typename Table>
+void lock_free_hash_table_sol(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
+    with_lock_free_map(config, [&](auto map_type) {
+        lock_free_hash_table_impl<typename decltype(map_type)::type>(config, table, trial_idx, do_print_stats, agg_res);
+    });
+}
+
+INSTANTIATE_ALG_FOR_ALL_LAYOUTS(lock_free_hash_table_sol);
@@ -0,0 +1,111 @@
+//! hybrid of radix partitioning and the lock-free table: one GrowableLockFreeAggMap per hash partition instead
+//! of one for the whole key space. each is sized from its own share of the sampled group count and grows on its
+//! own, so a migration only involves the threads that touch that partition while the rest keep going.
+//! partitions hold disjoint groups, so the output is written partition-parallel
+
+#include <memory>
+
+#include "../lib.hpp"
+
+template <typename LockFreeMap, typename Table>
+static void partitioned_lock_free_hash_table_impl(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res)
+{
+    typedef typename LockFreeMap::hasher Hasher;
+
+    chrono_time_point t_overall_0;
+    chrono_time_point t_overall_1;
+    chrono_time_point t_aggregate_0;
+    chrono_time_point t_aggregate_1;
+    chrono_time_point t_output_0;
+    chrono_time_point t_output_1;
+
+    t_overall_0 = std::chrono::steady_clock::now();
+
+    t_aggregate_0 = std::chrono::steady_clock::now();
+
+    auto n_rows = table.n_rows;
+    int num_threads = config.num_threads;
+    size_t n_partitions = config.num_threads * config.radix_partition_cnt_ratio;
+    if (do_print_stats) {
+        std::cout << ">>> run=" << trial_idx << ", n_partitions=" << n_partitions << std::endl;
+    }
+
+    std::vector<size_t> partition_group_counts = sample_partition_group_counts<Hasher>(table, n_partitions);
+    std::vector<std::unique_ptr<LockFreeMap>> partition_maps(n_partitions);
+    // the maps construct their slots with an omp loop of their own, nested here it runs on the calling thread
+    #pragma omp parallel for num_threads(num_threads) schedule(dynamic, 1)
+    for (size_t part_idx = 0; part_idx < n_partitions; part_idx++) {
+        partition_maps[part_idx] = std::make_unique<LockFreeMap>(partition_group_counts[part_idx], num_threads);
+    }
+
+    #pragma omp parallel num_threads(num_threads)
+    {
+        int tid = omp_get_thread_num();
+        #pragma omp for schedule(static)
+        for (int64_t r = 0; r < n_rows; r++)
+        {
+            int64_t key = table.get(r, 0);
+            uint64_t hash = Hasher{}(key);
+            partition_maps[hash_partition(hash, n_partitions)]->upsert(tid, hash, key, table.get(r, 1));
+        }
+    }
+
+    t_aggregate_1 = std::chrono::steady_clock::now();
+    time_print("aggregation_time", trial_idx, t_aggregate_0, t_aggregate_1, do_print_stats);
+
+    t_output_0 = std::chrono::steady_clock::now();
+
+    // every partition into its own rows first, then copied into place, both partition-parallel
+    for (auto &map : partition_maps) {
+        map->throw_if_dropped_updates();
+    }
+    std::vector<std::vector<AggResRow>> partition_res(n_partitions);
+    std::vector<size_t> partition_offsets(n_partitions + 1, agg_res.size());
+    #pragma omp parallel num_threads(num_threads)
+    {
+        #pragma omp for schedule(dynamic, 1)
+        for (size_t part_idx = 0; part_idx < n_partitions; part_idx++) {
+            partition_maps[part_idx]->for_each([&](const AggEntrySnapshot &entry) {
+                partition_res[part_idx].push_back(AggResRow{entry.key, entry.cnt, entry.sum, entry.min, entry.max});
+            });
+        }
+        #pragma omp single
+        {
+            for (size_t part_idx = 0; part_idx < n_partitions; part_idx++) {
+                partition_offsets[part_idx + 1] = partition_offsets[part_idx] + partition_res[part_idx].size();
+            }
+            agg_res.resize(partition_offsets[n_partitions]);
+        }
+        #pragma omp for schedule(dynamic, 1)
+        for (size_t part_idx = 0; part_idx < n_partitions; part_idx++) {
+            std::copy(partition_res[part_idx].begin(), partition_res[part_idx].end(), agg_res.begin() + partition_offsets[part_idx]);
+        }
+    }
+    if (do_print_stats) {
+        int n_migrations = 0;
+        size_t capacity = 0;
+        for (auto &map : partition_maps) {
+            n_migrations += map->n_migrations();
+            capacity += map->capacity();
+        }
+        std::cout << ">>> run=" << trial_idx << ", lock_free_migrations=" << n_migrations << std::endl;
+        std::cout << ">>> run=" << trial_idx << ", lock_free_capacity=" << capacity << std::endl;
+    }
+
+    t_output_1 = std::chrono::steady_clock::now();
+    time_print("write_output", trial_idx, t_output_0, t_output_1, do_print_stats);
+
+    t_overall_1 = std::chrono::steady_clock::now();
+    time_print("elapsed_time", trial_idx, t_overall_0, t_overall_1, do_print_stats);
+}
+
+// the entry layout comes from --lock_free_layout (atomic by default), the hash function from --hash,
+// the number of partitions from --radix_partition_cnt_ratio
+template <typename Table>
+void partitioned_lock_free_hash_table_sol(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
+    with_lock_free_map(config, [&](auto map_type) {
+        partitioned_lock_free_hash_table_impl<typename decltype(map_type)::type>(config, table, trial_idx, do_print_stats, agg_res);
+    });
+}
+
+INSTANTIATE_ALG_FOR_ALL_LAYOUTS(partitioned_lock_free_hash_table_sol);
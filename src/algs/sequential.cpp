@@ -2,7 +2,8 @@
 
 #include "../lib.hpp"
 
-void sequential_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
+template <typename Hasher, typename Table>
+static void sequential_impl(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
     assert(table.n_rows > 0);
     assert(table.n_cols > 0);
     
@@ -23,10 +24,8 @@ void sequential_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_p
     // doing sequential aggregation
     t_agg_0 = std::chrono::steady_clock::now();
     
-    SimpleHashAggMap agg_map;
-    for (size_t r = 0; r < n_rows; r++) {
-        agg_map.accumulate_from_row(table, r);
-    }
+    AggMap<StdMapBackend, Hasher> agg_map;
+    agg_map.accumulate_from_rows(table, 0, n_rows);
     
     t_agg_1 = std::chrono::steady_clock::now();
     time_print("aggregation_time", trial_idx, t_agg_0, t_agg_1, do_print_stats);
@@ -49,3 +48,5 @@ void sequential_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_p
     time_print("elapsed_time", trial_idx, t_overall_0, t_overall_1, do_print_stats);
 
 }
+
+DEFINE_HASHED_ALG_FOR_ALL_LAYOUTS(sequential_sol, sequential_impl<Hasher>);
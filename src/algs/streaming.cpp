@@ -0,0 +1,202 @@
+// approach: never materialize the input table, a loader thread pulls bounded batches from the input
+// while the worker threads run the scan phase of the chosen two-phase algorithm on each batch as it arrives
+// phase 1: load + local aggregation, overlapped, at most config.stream_max_batches batches buffered
+// phase 2: merge the per-thread maps the same way the in-memory algorithm would (central, tree or radix)
+
+#include <exception>
+#include <filesystem>
+#include <thread>
+
+#include "../lib.hpp"
+
+enum class StreamMergeEnum {
+    CENTRAL,
+    TREE,
+    RADIX,
+};
+
+template <typename AggMap>
+static void streaming_impl(ExpConfig &config, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
+    omp_set_num_threads(config.num_threads);
+
+    StreamMergeEnum merge_strat;
+    if (config.algorithm == "two-phase-central-merge" || config.algorithm == "two-phase-central-merge-xxhash") {
+        merge_strat = StreamMergeEnum::CENTRAL;
+    } else if (config.algorithm == "two-phase-tree-merge") {
+        merge_strat = StreamMergeEnum::TREE;
+    } else if (config.algorithm == "two-phase-radix" || config.algorithm == "two-phase-radix-xxhash") {
+        merge_strat = StreamMergeEnum::RADIX;
+    } else {
+        throw std::runtime_error("Unsupported algorithm for --streaming, use two-phase-central-merge, two-phase-tree-merge or two-phase-radix");
+    }
+
+    chrono_time_point t_overall_0;
+    chrono_time_point t_overall_1;
+    chrono_time_point t_agg_0;
+    chrono_time_point t_agg_1;
+    chrono_time_point t_load_1;
+    chrono_time_point t_phase1_0;
+    chrono_time_point t_phase1_1;
+    chrono_time_point t_phase2_0;
+    chrono_time_point t_phase2_1;
+    chrono_time_point t_output_0;
+    chrono_time_point t_output_1;
+    t_overall_0 = std::chrono::steady_clock::now();
+    t_agg_0 = std::chrono::steady_clock::now();
+
+    int n_cols = config.data_col_names.size() + 1;
+    int n_partitions = config.num_threads * config.radix_partition_cnt_ratio;
+
+    // the batch pool bounds how much of the input is in memory at any time
+    std::vector<RowStore> batch_pool(config.stream_max_batches);
+    BoundedQueue<RowStore *> free_batches(batch_pool.size());
+    BoundedQueue<RowStore *> full_batches(batch_pool.size());
+    for (auto &batch : batch_pool) {
+        batch.init_table(n_cols, config.stream_batch_rows);
+        free_batches.push(&batch);
+    }
+
+    auto local_agg_maps = std::vector<AggMap>(config.num_threads);
+    std::vector<std::vector<AggMap>> radix_partitions_local_maps;
+    if (merge_strat == StreamMergeEnum::RADIX) {
+        radix_partitions_local_maps.resize(n_partitions, std::vector<AggMap>(config.num_threads));
+    }
+
+    t_phase1_0 = std::chrono::steady_clock::now();
+    std::exception_ptr loader_error = nullptr;
+    std::thread loader([&]() {
+        try {
+            stream_batches(config, free_batches, full_batches);
+        } catch (...) {
+            loader_error = std::current_exception();
+            full_batches.close();
+        }
+        t_load_1 = std::chrono::steady_clock::now();
+    });
+
+    #pragma omp parallel
+    {
+        int tid = omp_get_thread_num();
+        int actual_num_threads = omp_get_num_threads();
+        assert(actual_num_threads == config.num_threads);
+
+
+
+        // === PHASE 1: pull batches and aggregate them as they arrive ===
+
+        AggMap local_agg_map;
+        std::vector<AggMap> local_radix_partitions(merge_strat == StreamMergeEnum::RADIX ? n_partitions : 0);
+
+        RowStore *batch;
+        while (full_batches.pop(batch)) {
+            if (merge_strat == StreamMergeEnum::RADIX) {
+                for (int64_t r = 0; r < batch->n_rows; r++) {
+                    int64_t group_key = batch->get(r, 0);
+                    uint64_t group_key_hash = typename AggMap::hasher{}(group_key);
+                    size_t part_idx = hash_partition(group_key_hash, n_partitions);
+                    local_radix_partitions[part_idx].accumulate_value(group_key_hash, group_key, batch->get(r, 1));
+                }
+            } else {
+                for (int64_t r = 0; r < batch->n_rows; r++) {
+                    local_agg_map.accumulate_from_row(*batch, r);
+                }
+            }
+            free_batches.push(batch);
+        }
+
+        if (merge_strat == StreamMergeEnum::RADIX) {
+            for (int part_idx = 0; part_idx < n_partitions; part_idx++) {
+                radix_partitions_local_maps[part_idx][tid] = std::move(local_radix_partitions[part_idx]);
+            }
+        } else {
+            local_agg_maps[tid] = std::move(local_agg_map);
+        }
+
+        #pragma omp barrier
+        if (tid == 0) {
+            t_phase1_1 = std::chrono::steady_clock::now();
+            time_print("phase_1", trial_idx, t_phase1_0, t_phase1_1, do_print_stats);
+            t_phase2_0 = std::chrono::steady_clock::now();
+        }
+
+
+
+        // === PHASE 2: merge ===
+
+        if (merge_strat == StreamMergeEnum::CENTRAL) {
+            if (tid == 0) {
+                for (int other_tid = 1; other_tid < actual_num_threads; other_tid++) {
+                    local_agg_maps[0].merge_from(local_agg_maps[other_tid]);
+                }
+            }
+        } else if (merge_strat == StreamMergeEnum::TREE) {
+            for (int merge_step = 2; merge_step <= actual_num_threads; merge_step *= 2) {
+                if (tid % merge_step == 0) {
+                    int other_tid = tid + (merge_step / 2);
+                    if (other_tid < actual_num_threads) {
+                        local_agg_maps[tid].merge_from(local_agg_maps[other_tid]);
+                    }
+                }
+                #pragma omp barrier
+            }
+        } else {
+            #pragma omp for schedule(dynamic, 1)
+            for (int part_idx = 0; part_idx < n_partitions; part_idx++) {
+                for (int other_tid = 1; other_tid < actual_num_threads; other_tid++) {
+                    radix_partitions_local_maps[part_idx][0].merge_from(radix_partitions_local_maps[part_idx][other_tid]);
+                }
+            }
+        }
+
+        #pragma omp barrier
+        if (tid == 0) {
+            t_phase2_1 = std::chrono::steady_clock::now();
+            time_print("phase_2", trial_idx, t_phase2_0, t_phase2_1, do_print_stats);
+        }
+    }
+
+    loader.join();
+    for (auto &batch : batch_pool) {
+        delete[] batch.data;
+    }
+    if (loader_error) {
+        std::rethrow_exception(loader_error);
+    }
+    time_print("load_time", trial_idx, t_phase1_0, t_load_1, do_print_stats);
+    uint64_t n_input_bytes = std::filesystem::file_size(config.dataset_file_path);
+    throughput_print("load_throughput", trial_idx, n_input_bytes, t_phase1_0, t_load_1, do_print_stats);
+
+    t_agg_1 = std::chrono::steady_clock::now();
+    time_print("aggregation_time", trial_idx, t_agg_0, t_agg_1, do_print_stats);
+    throughput_print("aggregation_throughput", trial_idx, n_input_bytes, t_agg_0, t_agg_1, do_print_stats);
+
+
+
+    // write output to vector
+    {
+        t_output_0 = std::chrono::steady_clock::now();
+        if (merge_strat == StreamMergeEnum::RADIX) {
+            for (int part_idx = 0; part_idx < n_partitions; part_idx++) {
+                for (auto& [group_key, agg_acc] : radix_partitions_local_maps[part_idx][0]) {
+                    agg_res.push_back(AggResRow{group_key, agg_acc[0], agg_acc[1], agg_acc[2], agg_acc[3]});
+                }
+            }
+        } else {
+            for (auto& [group_key, agg_acc] : local_agg_maps[0]) {
+                agg_res.push_back(AggResRow{group_key, agg_acc[0], agg_acc[1], agg_acc[2], agg_acc[3]});
+            }
+        }
+        t_output_1 = std::chrono::steady_clock::now();
+        time_print("write_output", trial_idx, t_output_0, t_output_1, do_print_stats);
+    }
+
+    t_overall_1 = std::chrono::steady_clock::now();
+    time_print("elapsed_time", trial_idx, t_overall_0, t_overall_1, do_print_stats);
+}
+
+// same local maps as the in-memory two-phase algorithms, picked with --map_backend
+void streaming_sol(ExpConfig &config, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
+    with_agg_map_backend(config, [&](auto map) {
+        streaming_impl<decltype(map)>(config, trial_idx, do_print_stats, agg_res);
+    });
+}
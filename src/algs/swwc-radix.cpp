@@ -0,0 +1,271 @@
+// approach: radix partition the rows themselves before aggregating anything
+// phase 1: histogram of the partition sizes, then every thread scatters its rows into one contiguous array per
+//          partition through software write-combining buffers: a cache line per partition collects rows and goes
+//          out whole with non-temporal stores, so the scatter keeps n_partitions lines hot instead of n_partitions maps
+// phase 2: aggregate each partition on its own, its table only holds that partition's groups. a partition whose
+//          estimated groups would still not fit in cache (80M-20M and up) is partitioned again first, on hash bits
+//          the earlier passes did not use, as many times as the estimate asks for
+
+#include <cstring>
+
+#include "../lib.hpp"
+
+struct PartitionedRow {
+    int64_t key;
+    int64_t val;
+};
+
+const int ROWS_PER_LINE = 64 / sizeof(PartitionedRow);
+
+struct alignas(64) CombineLine {
+    PartitionedRow rows[ROWS_PER_LINE];
+};
+
+// fan-out of one pass: every partition keeps a write-combining line, and each flush lands on that partition's
+// page, so more partitions than the TLB holds pages would miss on every flush
+const size_t MAX_PASS_FANOUT = 256;
+// partition again while a partition's estimated groups exceed this, 8K groups is an open addressing table of
+// about half a MB, inside L2
+const size_t CACHE_RESIDENT_GROUPS = 8192;
+// the combined fan-out of all passes stops here, the partition index comes from the top 32 hash bits
+const uint64_t MAX_COMBINED_FANOUT = 1ULL << 24;
+
+// one full line to 64 byte aligned dst, bypassing the cache
+static inline void stream_line(PartitionedRow *dst, const CombineLine &line) {
+#if defined(__AVX__)
+    const __m256i *src = reinterpret_cast<const __m256i *>(line.rows);
+    __m256i *out = reinterpret_cast<__m256i *>(dst);
+    _mm256_stream_si256(out, _mm256_load_si256(src));
+    _mm256_stream_si256(out + 1, _mm256_load_si256(src + 1));
+#elif defined(__SSE2__)
+    const __m128i *src = reinterpret_cast<const __m128i *>(line.rows);
+    __m128i *out = reinterpret_cast<__m128i *>(dst);
+    for (int i = 0; i < 4; i++) {
+        _mm_stream_si128(out + i, _mm_load_si128(src + i));
+    }
+#else
+    std::memcpy(dst, line.rows, sizeof(CombineLine));
+#endif
+}
+
+// scatter rows [row_lb, row_ub), row_at(r) each, into out, which is 64 byte aligned, partition p from write_pos[p]
+// on. a line only goes out whole once every row on it is ours (on or after range_lb[p]), the partial first and
+// last line of each range are copied row by row, so neighbouring ranges never overwrite each other
+template <typename RowAt, typename PartitionOf>
+static void scatter_rows(int64_t row_lb, int64_t row_ub, RowAt &&row_at, PartitionOf &&partition_of, size_t n_partitions, PartitionedRow *out, const std::vector<size_t> &range_lb, std::vector<size_t> &write_pos) {
+    std::vector<CombineLine> lines(n_partitions);
+    for (int64_t r = row_lb; r < row_ub; r++) {
+        PartitionedRow row = row_at(r);
+        size_t part_idx = partition_of(row.key);
+        size_t pos = write_pos[part_idx]++;
+        CombineLine &line = lines[part_idx];
+        line.rows[pos % ROWS_PER_LINE] = row;
+        if (pos % ROWS_PER_LINE == ROWS_PER_LINE - 1) {
+            size_t line_lb = pos + 1 - ROWS_PER_LINE;
+            if (line_lb >= range_lb[part_idx]) {
+                stream_line(&out[line_lb], line);
+            } else {
+                for (size_t i = range_lb[part_idx]; i <= pos; i++) {
+                    out[i] = line.rows[i % ROWS_PER_LINE];
+                }
+            }
+        }
+    }
+    for (size_t part_idx = 0; part_idx < n_partitions; part_idx++) {
+        size_t pos = write_pos[part_idx];
+        for (size_t i = std::max(pos - pos % ROWS_PER_LINE, range_lb[part_idx]); i < pos; i++) {
+            out[i] = lines[part_idx].rows[i % ROWS_PER_LINE];
+        }
+    }
+#if defined(__SSE2__)
+    _mm_sfence();
+#endif
+}
+
+// aggregate rows [lb, ub) of src, which went through passes with a combined fan-out of prefix_fanout, into res.
+// while the estimated groups do not fit in cache the rows are partitioned again into the same range of dst, and
+// every piece recurses with the buffers swapped. runs on one thread
+template <typename AggMap>
+static void aggregate_partition(PartitionedRow *src, PartitionedRow *dst, size_t lb, size_t ub, uint64_t prefix_fanout, float est_groups, int n_passes, std::vector<AggResRow> &res, int &max_passes) {
+    typedef typename AggMap::hasher Hasher;
+    size_t n_groups = std::min<size_t>(static_cast<size_t>(est_groups) + 1, ub - lb);
+    size_t fanout = 2;
+    while (fanout < MAX_PASS_FANOUT && fanout * CACHE_RESIDENT_GROUPS < n_groups) {
+        fanout *= 2;
+    }
+
+    if (n_groups <= CACHE_RESIDENT_GROUPS || prefix_fanout * fanout > MAX_COMBINED_FANOUT) {
+        AggMap agg_map;
+        agg_map.reserve(n_groups);
+        for (size_t i = lb; i < ub; i++) {
+            agg_map.accumulate_value(Hasher{}(src[i].key), src[i].key, src[i].val);
+        }
+        for (auto& [group_key, agg_acc] : agg_map) {
+            res.push_back(AggResRow{group_key, agg_acc[0], agg_acc[1], agg_acc[2], agg_acc[3]});
+        }
+        max_passes = std::max(max_passes, n_passes);
+        return;
+    }
+
+    auto partition_of = [&](int64_t group_key) { return sub_partition(Hasher{}(group_key), prefix_fanout, fanout); };
+    std::vector<size_t> sub_lb(fanout + 1, 0);
+    for (size_t i = lb; i < ub; i++) {
+        sub_lb[partition_of(src[i].key) + 1]++;
+    }
+    sub_lb[0] = lb;
+    for (size_t sub_idx = 0; sub_idx < fanout; sub_idx++) {
+        sub_lb[sub_idx + 1] += sub_lb[sub_idx];
+    }
+    std::vector<size_t> write_pos(sub_lb.begin(), sub_lb.end() - 1);
+    std::vector<size_t> range_lb = write_pos;
+    scatter_rows(lb, ub, [&](int64_t i) { return src[i]; }, partition_of, fanout, dst, range_lb, write_pos);
+
+    for (size_t sub_idx = 0; sub_idx < fanout; sub_idx++) {
+        aggregate_partition<AggMap>(dst, src, sub_lb[sub_idx], sub_lb[sub_idx + 1], prefix_fanout * fanout, est_groups / fanout, n_passes + 1, res, max_passes);
+    }
+}
+
+template <typename AggMap, typename Table>
+static void swwc_radix_impl(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
+    typedef typename AggMap::hasher Hasher;
+    omp_set_num_threads(config.num_threads);
+
+    auto n_rows = table.n_rows;
+    int num_threads = config.num_threads;
+
+    chrono_time_point t_overall_0;
+    chrono_time_point t_overall_1;
+    chrono_time_point t_agg_0;
+    chrono_time_point t_agg_1;
+    chrono_time_point t_phase1_0;
+    chrono_time_point t_phase1_1;
+    chrono_time_point t_phase2_0;
+    chrono_time_point t_phase2_1;
+    chrono_time_point t_output_0;
+    chrono_time_point t_output_1;
+
+    t_overall_0 = std::chrono::steady_clock::now();
+    t_agg_0 = std::chrono::steady_clock::now();
+
+    // the first pass fans out to at most MAX_PASS_FANOUT too, further passes are up to each partition
+    size_t n_partitions = std::max<size_t>(config.num_threads, std::min<size_t>(config.num_threads * config.radix_partition_cnt_ratio, MAX_PASS_FANOUT));
+    float G_hat = sample_group_count(table);
+    if (do_print_stats) {
+        std::cout << ">>> run=" << trial_idx << ", n_partitions=" << n_partitions << std::endl;
+        std::cout << ">>> run=" << trial_idx << ", G_hat=" << G_hat << std::endl;
+    }
+
+    // partition p of the scattered rows is partitioned[partition_lb[p], partition_lb[p + 1]), later passes
+    // scatter into the same range of scratch and back. scratch only gets paged in if a later pass runs
+    PartitionedRow *partitioned = static_cast<PartitionedRow *>(::operator new(n_rows * sizeof(PartitionedRow), std::align_val_t(64)));
+    PartitionedRow *scratch = static_cast<PartitionedRow *>(::operator new(n_rows * sizeof(PartitionedRow), std::align_val_t(64)));
+    std::vector<size_t> partition_lb(n_partitions + 1, 0);
+    // thread_counts[tid][p] rows of thread tid's range fall in p, thread_lb[tid][p] is where they go
+    std::vector<std::vector<size_t>> thread_counts(num_threads, std::vector<size_t>(n_partitions, 0));
+    std::vector<std::vector<size_t>> thread_lb(num_threads, std::vector<size_t>(n_partitions, 0));
+    std::vector<std::vector<AggResRow>> partition_res(n_partitions);
+    int max_passes = 1;
+
+    #pragma omp parallel reduction(max: max_passes)
+    {
+        int tid = omp_get_thread_num();
+        int actual_num_threads = omp_get_num_threads();
+        assert(actual_num_threads == num_threads);
+
+
+
+        // === PHASE 1: partition the rows ===
+
+        if (tid == 0) { t_phase1_0 = std::chrono::steady_clock::now(); }
+
+        // fixed ranges, the histogram and the scatter have to see the same rows. keys are hashed in both rather
+        // than keeping n_rows hashes around
+        int64_t row_lb = n_rows * tid / num_threads;
+        int64_t row_ub = n_rows * (tid + 1) / num_threads;
+        std::vector<size_t> &counts = thread_counts[tid];
+        for (int64_t r = row_lb; r < row_ub; r++) {
+            counts[hash_partition(Hasher{}(table.get(r, 0)), n_partitions)]++;
+        }
+        #pragma omp barrier
+
+        #pragma omp single
+        {
+            size_t pos = 0;
+            for (size_t part_idx = 0; part_idx < n_partitions; part_idx++) {
+                partition_lb[part_idx] = pos;
+                for (int other_tid = 0; other_tid < num_threads; other_tid++) {
+                    thread_lb[other_tid][part_idx] = pos;
+                    pos += thread_counts[other_tid][part_idx];
+                }
+            }
+            partition_lb[n_partitions] = pos;
+        }
+
+        std::vector<size_t> write_pos = thread_lb[tid];
+        scatter_rows(
+            row_lb, row_ub,
+            [&](int64_t r) { return PartitionedRow{table.get(r, 0), table.get(r, 1)}; },
+            [&](int64_t group_key) { return hash_partition(Hasher{}(group_key), n_partitions); },
+            n_partitions, partitioned, thread_lb[tid], write_pos
+        );
+        #pragma omp barrier
+
+        if (tid == 0) {
+            t_phase1_1 = std::chrono::steady_clock::now();
+            time_print("phase_1", trial_idx, t_phase1_0, t_phase1_1, do_print_stats);
+        }
+
+
+
+        // === PHASE 2: aggregate every partition on its own, partitioning it further first if need be ===
+
+        if (tid == 0) {
+            t_phase2_0 = std::chrono::steady_clock::now();
+        }
+
+        #pragma omp for schedule(dynamic, 1)
+        for (size_t part_idx = 0; part_idx < n_partitions; part_idx++) {
+            aggregate_partition<AggMap>(partitioned, scratch, partition_lb[part_idx], partition_lb[part_idx + 1], n_partitions, G_hat / n_partitions, 1, partition_res[part_idx], max_passes);
+        }
+
+        if (tid == 0) {
+            t_phase2_1 = std::chrono::steady_clock::now();
+            time_print("phase_2", trial_idx, t_phase2_0, t_phase2_1, do_print_stats);
+        }
+    }
+    ::operator delete(partitioned, std::align_val_t(64));
+    ::operator delete(scratch, std::align_val_t(64));
+
+    t_agg_1 = std::chrono::steady_clock::now();
+    time_print("aggregation_time", trial_idx, t_agg_0, t_agg_1, do_print_stats);
+    if (do_print_stats) {
+        std::cout << ">>> run=" << trial_idx << ", radix_passes=" << max_passes << std::endl;
+    }
+
+
+
+    // === one thread write out the result ===
+    {
+        t_output_0 = std::chrono::steady_clock::now();
+
+        for (size_t part_idx = 0; part_idx < n_partitions; part_idx++) {
+            agg_res.insert(agg_res.end(), partition_res[part_idx].begin(), partition_res[part_idx].end());
+        }
+
+        t_output_1 = std::chrono::steady_clock::now();
+        time_print("write_output", trial_idx, t_output_0, t_output_1, do_print_stats);
+    }
+
+    t_overall_1 = std::chrono::steady_clock::now();
+    time_print("elapsed_time", trial_idx, t_overall_0, t_overall_1, do_print_stats);
+}
+
+// the partition map type comes from --map_backend (open addressing by default)
+template <typename Table>
+void swwc_radix_sol(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
+    with_agg_map_backend(config, [&](auto map) {
+        swwc_radix_impl<decltype(map)>(config, table, trial_idx, do_print_stats, agg_res);
+    });
+}
+
+INSTANTIATE_ALG_FOR_ALL_LAYOUTS(swwc_radix_sol);
@@ -5,7 +5,8 @@
 
 #include "../lib.hpp"
 
-void three_phase_radix_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
+template <typename Hasher, typename Table>
+static void three_phase_radix_impl(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
     omp_set_num_threads(config.num_threads);
     
     auto n_cols = table.n_cols;
@@ -29,8 +30,11 @@ void three_phase_radix_sol(ExpConfig &config, RowStore &table, int trial_idx, bo
     
     t_agg_0 = std::chrono::steady_clock::now();
     int n_partitions = config.num_threads * config.radix_partition_cnt_ratio;
-    std::vector<std::vector<SimpleHashAggMap>> radix_partitions_local_maps(n_partitions, std::vector<SimpleHashAggMap>(config.num_threads));
-    // radix_partitions[2][3] is thread 3's result for partition 2
+    std::vector<std::vector<AggPayload>> radix_partitions_payloads(n_partitions, std::vector<AggPayload>(config.num_threads));
+    // radix_partitions_payloads[2][3] is thread 3's entries for partition 2, with their hashes
+    std::vector<PayloadAggMap<Hasher>> partition_agg_maps(n_partitions);
+    // splits partitions much larger than the average in the merge phase
+    RadixMergePlan<PayloadAggMap<Hasher>> merge_plan;
     
     std::cout << "n_partitions = " << n_partitions << std::endl;
     std::cout << "done initialising all the partitions" << std::endl;
@@ -44,7 +48,7 @@ void three_phase_radix_sol(ExpConfig &config, RowStore &table, int trial_idx, bo
         
         // === PHASE 1: local aggregation map === 
         
-        SimpleHashAggMap local_agg_map;
+        PayloadAggMap<Hasher> local_agg_map;
         
         if (tid == 0) { t_phase1_0 = std::chrono::steady_clock::now(); }
         
@@ -63,11 +67,8 @@ void three_phase_radix_sol(ExpConfig &config, RowStore &table, int trial_idx, bo
         
         // === PHASE 2: each thread break their map into partitions === 
         if (tid == 0) { t_phase2_0 = std::chrono::steady_clock::now(); }
-        for (auto& [group_key, agg_acc] : local_agg_map) {
-            size_t group_key_hash = std::hash<int64_t>{}(group_key);
-            size_t part_idx = group_key_hash % n_partitions;
-            radix_partitions_local_maps[part_idx][tid][group_key] = agg_acc;
-        }
+        // a scan over the payload routing entries by their stored hash, no map inserts
+        local_agg_map.scatter_to_partitions(radix_partitions_payloads, tid);
         #pragma omp barrier
         if (tid == 0) {
             t_phase2_1 = std::chrono::steady_clock::now();
@@ -79,17 +80,39 @@ void three_phase_radix_sol(ExpConfig &config, RowStore &table, int trial_idx, bo
 
         if (tid == 0) { t_phase3_0 = std::chrono::steady_clock::now(); }
 
+        #pragma omp single
+        {
+            std::vector<size_t> partition_sizes(n_partitions, 0);
+            for (int part_idx = 0; part_idx < n_partitions; part_idx++) {
+                for (auto &payload : radix_partitions_payloads[part_idx]) {
+                    partition_sizes[part_idx] += payload.size();
+                }
+            }
+            merge_plan.plan(partition_sizes, actual_num_threads);
+        }
+
         #pragma omp for schedule(dynamic, 1)
-        for (size_t part_idx = 0; part_idx < n_partitions; part_idx++) {
-            for (size_t other_tid = 1; other_tid < actual_num_threads; other_tid++) {
-                auto other_local_agg_map = radix_partitions_local_maps[part_idx][other_tid];
-                radix_partitions_local_maps[part_idx][0].merge_from(other_local_agg_map);
+        for (size_t task_idx = 0; task_idx < merge_plan.n_scatter_tasks(); task_idx++) {
+            auto task = merge_plan.scatter_task(task_idx);
+            merge_plan.scatter(task.part_idx, task.idx, radix_partitions_payloads[task.part_idx][task.idx]);
+        }
+
+        #pragma omp for schedule(dynamic, 1)
+        for (size_t task_idx = 0; task_idx < merge_plan.n_merge_tasks(); task_idx++) {
+            size_t part_idx = merge_plan.merge_task(task_idx).part_idx;
+            if (merge_plan.is_split(part_idx)) {
+                merge_plan.merge_piece(part_idx, merge_plan.merge_task(task_idx).idx);
+                continue;
+            }
+            for (size_t other_tid = 0; other_tid < actual_num_threads; other_tid++) {
+                partition_agg_maps[part_idx].merge_from(radix_partitions_payloads[part_idx][other_tid]);
             }
         }
         
         if (tid == 0) {
             t_phase3_1 = std::chrono::steady_clock::now();
             time_print("phase_3", trial_idx, t_phase3_0, t_phase3_1, do_print_stats);
+            merge_plan.stats_print(trial_idx, do_print_stats);
         }
 
     }
@@ -102,7 +125,15 @@ void three_phase_radix_sol(ExpConfig &config, RowStore &table, int trial_idx, bo
         t_output_0 = std::chrono::steady_clock::now();
         
         for (size_t part_idx = 0; part_idx < n_partitions; part_idx++) {
-            for (auto& [group_key, agg_acc] : radix_partitions_local_maps[part_idx][0]) {
+            if (merge_plan.is_split(part_idx)) {
+                for (auto &piece_map : merge_plan.pieces(part_idx)) {
+                    for (auto& [group_key, agg_acc] : piece_map) {
+                        agg_res.push_back(AggResRow{group_key, agg_acc[0], agg_acc[1], agg_acc[2], agg_acc[3]});
+                    }
+                }
+                continue;
+            }
+            for (auto& [group_key, agg_acc] : partition_agg_maps[part_idx]) {
                 agg_res.push_back(AggResRow{group_key, agg_acc[0], agg_acc[1], agg_acc[2], agg_acc[3]});
             }
         }
@@ -114,3 +145,5 @@ void three_phase_radix_sol(ExpConfig &config, RowStore &table, int trial_idx, bo
     t_overall_1 = std::chrono::steady_clock::now();
     time_print("elapsed_time", trial_idx, t_overall_0, t_overall_1, do_print_stats);
 }
+
+DEFINE_HASHED_ALG_FOR_ALL_LAYOUTS(three_phase_radix_sol, three_phase_radix_impl<Hasher>);
@@ -4,7 +4,8 @@
 
 #include "../lib.hpp"
 
-void two_phase_radix_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
+template <typename AggMap, typename Table>
+static void two_phase_radix_impl(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
     omp_set_num_threads(config.num_threads);
     
     auto n_cols = table.n_cols;
@@ -27,9 +28,16 @@ void two_phase_radix_sol(ExpConfig &config, RowStore &table, int trial_idx, bool
     int n_partitions = config.num_threads * config.radix_partition_cnt_ratio;
     
     // radix_partitions being a size n_thread array of n_thread array of local agg maps
-    std::vector<std::vector<SimpleHashAggMap>> radix_partitions_local_maps(n_partitions, std::vector<SimpleHashAggMap>(config.num_threads));
+    std::vector<std::vector<AggMap>> radix_partitions_local_maps(n_partitions, std::vector<AggMap>(config.num_threads));
     // radix_partitions[2][3] is thread 3's result for partition 2
     
+    // with --heavy_hitters, rows of very frequent keys skip their partition
+    HeavyHitterLayer heavy_hitters(config.num_threads);
+    bool use_heavy_hitters = config.heavy_hitters;
+    
+    // splits partitions much larger than the average in phase 2
+    RadixMergePlan<AggMap> merge_plan;
+    
     std::cout << "n_partitions = " << n_partitions << std::endl;
     std::cout << "done initialising all the partitions" << std::endl;
     
@@ -43,19 +51,26 @@ void two_phase_radix_sol(ExpConfig &config, RowStore &table, int trial_idx, bool
         
         // === PHASE 1: aggregate into partition and local aggregation map === 
         
-        std::vector<SimpleHashAggMap> local_radix_partitions(n_partitions);
+        std::vector<AggMap> local_radix_partitions(n_partitions);
         
         if (tid == 0) { t_phase1_0 = std::chrono::steady_clock::now(); }
         
         #pragma omp for schedule(dynamic, config.batch_size)
         for (size_t r = 0; r < n_rows; r++) {
             int64_t group_key = table.get(r, 0);
+            if (use_heavy_hitters && heavy_hitters.accumulate(tid, group_key, table.get(r, 1))) {
+                continue;
+            }
             
-            size_t group_key_hash = std::hash<int64_t>{}(group_key);
-            size_t part_idx = group_key_hash % n_partitions;
+            uint64_t group_key_hash = typename AggMap::hasher{}(group_key);
+            size_t part_idx = hash_partition(group_key_hash, n_partitions);
             
-            local_radix_partitions[part_idx].accumulate_from_row(table, r);
+            local_radix_partitions[part_idx].accumulate_value(group_key_hash, group_key, table.get(r, 1));
         }
+        heavy_hitters.for_each_hot(tid, [&](int64_t group_key, const AggMapValue &agg_acc) {
+            uint64_t group_key_hash = typename AggMap::hasher{}(group_key);
+            local_radix_partitions[hash_partition(group_key_hash, n_partitions)].accumulate_from_agg_acc(group_key_hash, group_key, agg_acc);
+        });
         for (size_t part_idx = 0; part_idx < n_partitions; part_idx++) {
             radix_partitions_local_maps[part_idx][tid] = local_radix_partitions[part_idx];
         }
@@ -64,6 +79,10 @@ void two_phase_radix_sol(ExpConfig &config, RowStore &table, int trial_idx, bool
         if (tid == 0) {
             t_phase1_1 = std::chrono::steady_clock::now();
             time_print("phase_1", trial_idx, t_phase1_0, t_phase1_1, do_print_stats);
+            probe_stats_print(radix_partitions_local_maps, trial_idx, do_print_stats);
+            if (use_heavy_hitters) {
+                heavy_hitters.stats_print(trial_idx, do_print_stats);
+            }
         }
         
         
@@ -74,8 +93,30 @@ void two_phase_radix_sol(ExpConfig &config, RowStore &table, int trial_idx, bool
             t_phase2_0 = std::chrono::steady_clock::now();
         }
 
+        #pragma omp single
+        {
+            std::vector<size_t> partition_sizes(n_partitions, 0);
+            for (int part_idx = 0; part_idx < n_partitions; part_idx++) {
+                for (auto &local_agg_map : radix_partitions_local_maps[part_idx]) {
+                    partition_sizes[part_idx] += local_agg_map.size();
+                }
+            }
+            merge_plan.plan(partition_sizes, actual_num_threads);
+        }
+        
         #pragma omp for schedule(dynamic, 1)
-        for (size_t part_idx = 0; part_idx < n_partitions; part_idx++) {
+        for (size_t task_idx = 0; task_idx < merge_plan.n_scatter_tasks(); task_idx++) {
+            auto task = merge_plan.scatter_task(task_idx);
+            merge_plan.scatter(task.part_idx, task.idx, radix_partitions_local_maps[task.part_idx][task.idx]);
+        }
+        
+        #pragma omp for schedule(dynamic, 1)
+        for (size_t task_idx = 0; task_idx < merge_plan.n_merge_tasks(); task_idx++) {
+            size_t part_idx = merge_plan.merge_task(task_idx).part_idx;
+            if (merge_plan.is_split(part_idx)) {
+                merge_plan.merge_piece(part_idx, merge_plan.merge_task(task_idx).idx);
+                continue;
+            }
             for (size_t other_tid = 1; other_tid < actual_num_threads; other_tid++) {
                 auto other_local_agg_map = radix_partitions_local_maps[part_idx][other_tid];
                 radix_partitions_local_maps[part_idx][0].merge_from(other_local_agg_map);
@@ -85,6 +126,7 @@ void two_phase_radix_sol(ExpConfig &config, RowStore &table, int trial_idx, bool
         if (tid == 0) {
             t_phase2_1 = std::chrono::steady_clock::now();
             time_print("phase_2", trial_idx, t_phase2_0, t_phase2_1, do_print_stats);
+            merge_plan.stats_print(trial_idx, do_print_stats);
         }
 
     }
@@ -99,6 +141,14 @@ void two_phase_radix_sol(ExpConfig &config, RowStore &table, int trial_idx, bool
         t_output_0 = std::chrono::steady_clock::now();
         
         for (size_t part_idx = 0; part_idx < n_partitions; part_idx++) {
+            if (merge_plan.is_split(part_idx)) {
+                for (auto &piece_map : merge_plan.pieces(part_idx)) {
+                    for (auto& [group_key, agg_acc] : piece_map) {
+                        agg_res.push_back(AggResRow{group_key, agg_acc[0], agg_acc[1], agg_acc[2], agg_acc[3]});
+                    }
+                }
+                continue;
+            }
             for (auto& [group_key, agg_acc] : radix_partitions_local_maps[part_idx][0]) {
                 agg_res.push_back(AggResRow{group_key, agg_acc[0], agg_acc[1], agg_acc[2], agg_acc[3]});
             }
@@ -111,3 +161,13 @@ void two_phase_radix_sol(ExpConfig &config, RowStore &table, int trial_idx, bool
     t_overall_1 = std::chrono::steady_clock::now();
     time_print("elapsed_time", trial_idx, t_overall_0, t_overall_1, do_print_stats);
 }
+
+// the local map type comes from --map_backend (open addressing by default)
+template <typename Table>
+void two_phase_radix_sol(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
+    with_agg_map_backend(config, [&](auto map) {
+        two_phase_radix_impl<decltype(map)>(config, table, trial_idx, do_print_stats, agg_res);
+    });
+}
+
+INSTANTIATE_ALG_FOR_ALL_LAYOUTS(two_phase_radix_sol);
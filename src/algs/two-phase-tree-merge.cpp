@@ -2,7 +2,8 @@
 
 // phase 1: each thread does local aggregation
 // phase 2: threads go merge
-void two_phase_tree_merge_sol(ExpConfig &config, RowStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
+template <typename AggMap, typename Table>
+static void two_phase_tree_merge_impl(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
     omp_set_num_threads(config.num_threads);
     
     auto n_cols = table.n_cols;
@@ -23,9 +24,9 @@ void two_phase_tree_merge_sol(ExpConfig &config, RowStore &table, int trial_idx,
     
     t_agg_0 = std::chrono::steady_clock::now();
 
-    auto local_agg_maps = std::vector<XXHashAggMap>(config.num_threads);
+    auto local_agg_maps = std::vector<AggMap>(config.num_threads);
     assert(local_agg_maps.size() == config.num_threads);
-    XXHashAggMap agg_map; // where merged results go
+    AggMap agg_map; // where merged results go
     
     #pragma omp parallel
     {
@@ -34,13 +35,14 @@ void two_phase_tree_merge_sol(ExpConfig &config, RowStore &table, int trial_idx,
         assert(actual_num_threads == config.num_threads);
         
         // PHASE 1: local aggregation map
-        XXHashAggMap local_agg_map;
+        AggMap local_agg_map;
         
         if (tid == 0) { t_phase1_0 = std::chrono::steady_clock::now(); }
         
-        #pragma omp for schedule(dynamic, config.batch_size)
-        for (size_t r = 0; r < n_rows; r++) {
-            local_agg_map.accumulate_from_row(table, r);
+        // one batch per iteration, so packed layouts can decode a batch at a time
+        #pragma omp for schedule(dynamic, 1)
+        for (int64_t batch_lb = 0; batch_lb < n_rows; batch_lb += config.batch_size) {
+            local_agg_map.accumulate_from_rows(table, batch_lb, std::min<int64_t>(batch_lb + config.batch_size, n_rows));
         }
         local_agg_maps[tid] = local_agg_map;
         
@@ -48,6 +50,7 @@ void two_phase_tree_merge_sol(ExpConfig &config, RowStore &table, int trial_idx,
         if (tid == 0) {
             t_phase1_1 = std::chrono::steady_clock::now();
             time_print("phase_1", trial_idx, t_phase1_0, t_phase1_1, do_print_stats);
+            probe_stats_print(local_agg_maps, trial_idx, do_print_stats);
             t_phase2_0 = std::chrono::steady_clock::now();
         }
         
@@ -90,3 +93,13 @@ void two_phase_tree_merge_sol(ExpConfig &config, RowStore &table, int trial_idx,
     time_print("elapsed_time", trial_idx, t_overall_0, t_overall_1, do_print_stats);
 
 }
+
+// the local map type comes from --map_backend (open addressing by default)
+template <typename Table>
+void two_phase_tree_merge_sol(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
+    with_agg_map_backend(config, [&](auto map) {
+        two_phase_tree_merge_impl<decltype(map)>(config, table, trial_idx, do_print_stats, agg_res);
+    });
+}
+
+INSTANTIATE_ALG_FOR_ALL_LAYOUTS(two_phase_tree_merge_sol);
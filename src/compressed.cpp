@@ -0,0 +1,175 @@
+//! compressed binary datasets (.zbin): same columns as a .bin, cut into chunks of chunk_rows rows
+//! with every column of every chunk deflated on its own, so the file stays small on shared storage
+//! and readers can inflate chunks in parallel, or overlap inflating with aggregation (--streaming)
+
+#include "lib.hpp"
+#include <atomic>
+#include <cassert>
+#include <fcntl.h>
+#include <fstream>
+#include <omp.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+// fast deflate level, integer columns compress about as well at 1 as at 6 and inflate the same
+const int COMPRESSED_DATASET_LEVEL = 1;
+
+bool is_compressed_dataset_path(const std::string &path) {
+    const std::string ext = ".zbin";
+    return path.size() >= ext.size() && path.compare(path.size() - ext.size(), ext.size(), ext) == 0;
+}
+
+void write_compressed_dataset(const std::string &path, ColumnStore &table, int64_t chunk_rows, int num_threads) {
+    assert(table.n_cols <= BINARY_DATASET_MAX_COLS);
+    assert(chunk_rows > 0);
+
+    CompressedDatasetHeader header{};
+    header.magic = COMPRESSED_DATASET_MAGIC;
+    header.version = COMPRESSED_DATASET_VERSION;
+    header.n_cols = table.n_cols;
+    header.n_rows = table.n_rows;
+    header.chunk_rows = chunk_rows;
+    header.n_chunks = (table.n_rows + chunk_rows - 1) / chunk_rows;
+    for (int c = 0; c < table.n_cols; c++) {
+        header.col_types[c] = BINARY_COL_INT64;
+    }
+
+    std::vector<char> header_page(BINARY_DATASET_HEADER_SIZE, 0);
+    std::memcpy(header_page.data(), &header, sizeof(header));
+    std::vector<CompressedChunkEntry> entries(header.n_chunks * header.n_cols);
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("cannot open " + path + " for writing");
+    }
+    // directory gets rewritten with the real offsets once all chunks are out
+    out.write(header_page.data(), header_page.size());
+    out.write(reinterpret_cast<const char *>(entries.data()), sizeof(CompressedChunkEntry) * entries.size());
+    uint64_t offset = BINARY_DATASET_HEADER_SIZE + sizeof(CompressedChunkEntry) * entries.size();
+
+    // deflate a wave of chunks in parallel, then append them in order, so memory stays bounded
+    const int64_t chunks_per_wave = 4 * num_threads;
+    std::vector<std::string> compressed(chunks_per_wave * header.n_cols);
+    std::atomic<bool> failed(false);
+    omp_set_num_threads(num_threads);
+    for (int64_t wave_lb = 0; wave_lb < static_cast<int64_t>(header.n_chunks); wave_lb += chunks_per_wave) {
+        int64_t wave_ub = std::min<int64_t>(wave_lb + chunks_per_wave, header.n_chunks);
+
+        #pragma omp parallel for schedule(dynamic, 1) collapse(2)
+        for (int64_t chunk_idx = wave_lb; chunk_idx < wave_ub; chunk_idx++) {
+            for (int c = 0; c < table.n_cols; c++) {
+                int64_t row_lb = chunk_idx * chunk_rows;
+                uLong src_size = sizeof(int64_t) * std::min(chunk_rows, table.n_rows - row_lb);
+                const Bytef *src = reinterpret_cast<const Bytef *>(&table.data[table.get_idx(row_lb, c)]);
+
+                std::string &dst = compressed[(chunk_idx - wave_lb) * table.n_cols + c];
+                uLongf dst_size = compressBound(src_size);
+                dst.resize(dst_size);
+                if (compress2(reinterpret_cast<Bytef *>(&dst[0]), &dst_size, src, src_size, COMPRESSED_DATASET_LEVEL) != Z_OK) {
+                    failed = true;
+                }
+                dst.resize(dst_size);
+                entries[chunk_idx * table.n_cols + c].checksum = XXH3_64bits(src, src_size);
+            }
+        }
+        if (failed) {
+            throw std::runtime_error("failed compressing " + path);
+        }
+
+        for (int64_t chunk_idx = wave_lb; chunk_idx < wave_ub; chunk_idx++) {
+            for (int c = 0; c < table.n_cols; c++) {
+                const std::string &chunk_col = compressed[(chunk_idx - wave_lb) * table.n_cols + c];
+                entries[chunk_idx * table.n_cols + c].offset = offset;
+                entries[chunk_idx * table.n_cols + c].compressed_size = chunk_col.size();
+                out.write(chunk_col.data(), chunk_col.size());
+                offset += chunk_col.size();
+            }
+        }
+    }
+
+    out.seekp(BINARY_DATASET_HEADER_SIZE);
+    out.write(reinterpret_cast<const char *>(entries.data()), sizeof(CompressedChunkEntry) * entries.size());
+    if (!out) {
+        throw std::runtime_error("failed writing " + path);
+    }
+}
+
+void map_compressed_dataset(const std::string &path, CompressedDatasetView &view) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < BINARY_DATASET_HEADER_SIZE) {
+        close(fd);
+        throw std::runtime_error(path + " is too small to be a compressed dataset");
+    }
+    view.file_size = st.st_size;
+
+    // chunks are only read once, front to back per reader, so let the kernel read ahead
+    void *base = mmap(nullptr, view.file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        throw std::runtime_error("cannot mmap " + path);
+    }
+    madvise(base, view.file_size, MADV_SEQUENTIAL);
+    view.base = static_cast<char *>(base);
+
+    std::memcpy(&view.header, view.base, sizeof(view.header));
+    const CompressedDatasetHeader &header = view.header;
+    if (header.magic != COMPRESSED_DATASET_MAGIC || header.version != COMPRESSED_DATASET_VERSION) {
+        unmap_compressed_dataset(view);
+        throw std::runtime_error(path + " is not a compressed dataset of a supported version");
+    }
+    if (header.n_cols > BINARY_DATASET_MAX_COLS) {
+        unmap_compressed_dataset(view);
+        throw std::runtime_error(path + " has more columns than a compressed dataset can hold");
+    }
+    for (uint32_t c = 0; c < header.n_cols; c++) {
+        if (header.col_types[c] != BINARY_COL_INT64) {
+            unmap_compressed_dataset(view);
+            throw std::runtime_error(path + " has a column type we cannot read");
+        }
+    }
+
+    // every chunk but the last must be full, otherwise chunk_n_rows goes negative or rows are never filled in
+    if (header.chunk_rows == 0 || header.n_chunks != header.n_rows / header.chunk_rows + (header.n_rows % header.chunk_rows != 0)) {
+        unmap_compressed_dataset(view);
+        throw std::runtime_error(path + " has a chunk count that does not match its rows");
+    }
+
+    // compared by division, so corrupt counts cannot wrap around the size computations
+    uint64_t max_entries = (view.file_size - BINARY_DATASET_HEADER_SIZE) / sizeof(CompressedChunkEntry);
+    view.entries = reinterpret_cast<const CompressedChunkEntry *>(view.base + BINARY_DATASET_HEADER_SIZE);
+    bool truncated = header.n_cols > 0 && header.n_chunks > max_entries / header.n_cols;
+    for (uint64_t entry_idx = 0; !truncated && entry_idx < header.n_chunks * header.n_cols; entry_idx++) {
+        const CompressedChunkEntry &entry = view.entries[entry_idx];
+        truncated = entry.compressed_size > view.file_size || entry.offset > view.file_size - entry.compressed_size;
+    }
+    if (truncated) {
+        unmap_compressed_dataset(view);
+        throw std::runtime_error(path + " is truncated");
+    }
+}
+
+void unmap_compressed_dataset(CompressedDatasetView &view) {
+    munmap(view.base, view.file_size);
+    view.base = nullptr;
+    view.entries = nullptr;
+}
+
+void inflate_compressed_chunk(const CompressedDatasetView &view, int64_t chunk_idx, int col_idx, int64_t *dst, bool verify_checksum) {
+    const CompressedChunkEntry &entry = view.entries[chunk_idx * view.header.n_cols + col_idx];
+    uLongf dst_size = sizeof(int64_t) * view.chunk_n_rows(chunk_idx);
+    uLongf expected_size = dst_size;
+    int ret = uncompress(reinterpret_cast<Bytef *>(dst), &dst_size, reinterpret_cast<const Bytef *>(view.base + entry.offset), entry.compressed_size);
+    if (ret != Z_OK || dst_size != expected_size) {
+        throw std::runtime_error("failed to inflate chunk " + std::to_string(chunk_idx) + " column " + std::to_string(col_idx));
+    }
+    if (verify_checksum && XXH3_64bits(dst, dst_size) != entry.checksum) {
+        throw std::runtime_error("chunk " + std::to_string(chunk_idx) + " column " + std::to_string(col_idx) + " failed checksum verification");
+    }
+}
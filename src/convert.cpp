@@ -0,0 +1,83 @@
+/**
+ * @file convert.cpp
+ * @brief Convert a generated gzip CSV dataset into the binary columnar format
+ * that ./main can mmap directly, so later runs skip decompression and parsing,
+ * or (with --compress) into chunked, deflated columns that stay small on disk.
+ */
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include <CLI11.hpp>
+
+#include "lib.hpp"
+
+int main(int argc, char** argv)
+{
+    /**
+     * Parse command line arguments
+     */
+    CLI::App app
+    {
+        "Convert a key,val CSV dataset (e.g. data/<dist>/<rows>-<groups>.csv.gz) "
+        "into a binary columnar dataset for ./main."
+    };
+
+    ExpConfig config;
+    config.num_threads = 1;
+    config.verify_checksum = false;
+    config.loader = "duckdb";
+    config.group_key_col_name = "key";
+    config.data_col_names = {"val"};
+
+    std::string output_path = "";
+    bool compress = false;
+    int64_t chunk_rows = 1 << 20;
+    app.add_option("--input", config.dataset_file_path, "Path to the gzipped CSV input file")->check(CLI::ExistingFile)->required();
+    app.add_option("--output", output_path, "Path of the binary dataset to write (default: input with .csv.gz replaced by .bin, or .zbin with --compress)");
+    app.add_flag("--compress", compress, "Write a compressed .zbin dataset of independently deflated column chunks");
+    app.add_option("--chunk_rows", chunk_rows, "Rows per compressed chunk with --compress")->check(CLI::PositiveNumber);
+    app.add_option("--num_threads", config.num_threads, "Number of threads to use while loading");
+    app.add_option("--loader", config.loader, "How to load the csv: duckdb, or native (our own parallel simd parser)")->check(CLI::IsMember({"duckdb", "native"}));
+
+    CLI11_PARSE(app, argc, argv);
+
+    if (output_path.empty())
+    {
+        output_path = config.dataset_file_path;
+        for (const std::string ext : {".gz", ".csv"})
+        {
+            if (output_path.size() >= ext.size() && output_path.compare(output_path.size() - ext.size(), ext.size(), ext) == 0)
+            {
+                output_path.resize(output_path.size() - ext.size());
+            }
+        }
+        output_path += compress ? ".zbin" : ".bin";
+    }
+    if (compress ? !is_compressed_dataset_path(output_path) : !is_binary_dataset_path(output_path))
+    {
+        std::cerr << "Error: --output must end in " << (compress ? ".zbin" : ".bin") << " so ./main recognises it." << std::endl;
+        return 1;
+    }
+
+    /**
+     * Load through duckdb once, column major, then dump the columns as is
+     */
+    ColumnStore table;
+    auto t_0 = std::chrono::steady_clock::now();
+    load_data(config, table);
+    auto t_1 = std::chrono::steady_clock::now();
+    if (compress)
+    {
+        write_compressed_dataset(output_path, table, chunk_rows, config.num_threads);
+    }
+    else
+    {
+        write_binary_dataset(output_path, table);
+    }
+    auto t_2 = std::chrono::steady_clock::now();
+
+    std::cout << "loaded in " << std::chrono::duration_cast<std::chrono::milliseconds>(t_1 - t_0).count() << "ms, ";
+    std::cout << "wrote " << output_path << " in " << std::chrono::duration_cast<std::chrono::milliseconds>(t_2 - t_1).count() << "ms" << std::endl;
+}
@@ -0,0 +1,285 @@
+//! native loader for our generated integer csv files (header line, then key,val rows)
+//! reads the whole file, then parses it in parallel chunks straight into the table
+
+#include "gzip-index.hpp"
+#include "lib.hpp"
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <omp.h>
+#include <fcntl.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// bytes of zero padding after the text, so the simd loads below may read past the last row
+const size_t CSV_PADDING = 64;
+
+// inflate every member listed in the sidecar index in parallel, each straight into its slice of the text
+// returns false if there is no usable index and the caller should fall back to a serial read
+static bool read_indexed_gzip_file(const std::string &path, int num_threads, std::string &text) {
+    std::vector<GzipMemberEntry> members;
+    if (!read_gzip_index(path, members) || members.empty()) {
+        return false;
+    }
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || members.back().compressed_offset + members.back().compressed_size != static_cast<uint64_t>(st.st_size)) {
+        std::cout << "ignoring stale gzip index " << gzip_index_path(path) << std::endl;
+        return false;
+    }
+
+    std::vector<uint64_t> uncompressed_offsets(members.size() + 1, 0);
+    for (size_t member_idx = 0; member_idx < members.size(); member_idx++) {
+        uncompressed_offsets[member_idx + 1] = uncompressed_offsets[member_idx] + members[member_idx].uncompressed_size;
+    }
+    text.resize(uncompressed_offsets.back());
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open " + path);
+    }
+    std::atomic<bool> failed(false);
+    omp_set_num_threads(num_threads);
+    #pragma omp parallel
+    {
+        std::vector<char> compressed;
+        #pragma omp for schedule(dynamic, 1)
+        for (size_t member_idx = 0; member_idx < members.size(); member_idx++) {
+            const GzipMemberEntry &member = members[member_idx];
+            compressed.resize(member.compressed_size);
+            ssize_t n_read = pread(fd, compressed.data(), member.compressed_size, member.compressed_offset);
+            if (n_read != static_cast<ssize_t>(member.compressed_size) ||
+                !gzip_decompress_member(compressed.data(), compressed.size(), &text[uncompressed_offsets[member_idx]], member.uncompressed_size)) {
+                failed = true;
+            }
+        }
+    }
+    close(fd);
+    if (failed) {
+        throw std::runtime_error("failed to decompress " + path + " using " + gzip_index_path(path));
+    }
+    std::cout << "decompressed " << members.size() << " gzip members in parallel" << std::endl;
+    return true;
+}
+
+// read a whole file into memory, gzip or plain (zlib reads plain files transparently)
+// gzip files written by generate come with a member index and are inflated on all threads
+std::string read_text_file(const std::string &path, int num_threads) {
+    std::string text;
+    if (read_indexed_gzip_file(path, num_threads, text)) {
+        return text;
+    }
+
+    gzFile file = gzopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        throw std::runtime_error("cannot open " + path);
+    }
+    gzbuffer(file, 1 << 20);
+
+    size_t len = 0;
+    const size_t read_size = 1 << 24;
+    while (true) {
+        text.resize(len + read_size);
+        int n = gzread(file, &text[len], read_size);
+        if (n < 0) {
+            gzclose(file);
+            throw std::runtime_error("failed to decompress " + path);
+        }
+        len += n;
+        if (n == 0) {
+            break;
+        }
+    }
+    gzclose(file);
+    text.resize(len);
+    return text;
+}
+
+// count '\n' in [begin, end), 32 or 16 bytes per compare
+static int64_t count_newlines(const char *begin, const char *end) {
+    int64_t count = 0;
+    const char *p = begin;
+#if defined(__AVX2__)
+    const __m256i newline = _mm256_set1_epi8('\n');
+    for (; p + 32 <= end; p += 32) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        count += __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, newline)));
+    }
+#elif defined(__SSE2__)
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; p + 16 <= end; p += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        count += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)));
+    }
+#endif
+    for (; p < end; p++) {
+        count += (*p == '\n');
+    }
+    return count;
+}
+
+// length of the run of ascii digits starting at p (reads 16 bytes, relies on CSV_PADDING)
+static inline int digit_run_length(const char *p) {
+#if defined(__SSE2__)
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    __m128i shifted = _mm_sub_epi8(bytes, _mm_set1_epi8('0'));
+    __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(9)), shifted);
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(is_digit));
+    return __builtin_ctz(~mask); // at most 16
+#else
+    int len = 0;
+    while (len < 16 && static_cast<unsigned char>(p[len] - '0') <= 9) {
+        len++;
+    }
+    return len;
+#endif
+}
+
+// value of len (1..8) ascii digits at p, folded with swar multiplies instead of a per-digit loop
+static inline uint64_t parse_up_to_8_digits(const char *p, int len) {
+    uint64_t word;
+    std::memcpy(&word, p, sizeof(word));
+    word <<= (8 - len) * 8; // drop bytes after the digits, leading zero bytes act as '0'
+    word = (word & 0x0F0F0F0F0F0F0F0FULL) * 2561 >> 8;
+    word = (word & 0x00FF00FF00FF00FFULL) * 6553601 >> 16;
+    return (word & 0x0000FFFF0000FFFFULL) * 42949672960001ULL >> 32;
+}
+
+// parse an optionally negative int64 at p, returns the position after it or nullptr if there are no digits
+static inline const char *parse_int64(const char *p, int64_t &out) {
+    bool negative = (*p == '-');
+    p += negative;
+
+    int len = digit_run_length(p);
+    uint64_t value;
+    if (len == 0) {
+        return nullptr;
+    } else if (len <= 8) {
+        value = parse_up_to_8_digits(p, len);
+    } else if (len < 16) {
+        value = parse_up_to_8_digits(p, len - 8) * 100000000ULL + parse_up_to_8_digits(p + len - 8, 8);
+    } else {
+        // 16+ digits never show up in our datasets, fall back to the plain loop
+        value = 0;
+        len = 0;
+        while (static_cast<unsigned char>(p[len] - '0') <= 9) {
+            value = value * 10 + (p[len] - '0');
+            len++;
+        }
+    }
+    out = negative ? -static_cast<int64_t>(value) : static_cast<int64_t>(value);
+    return p + len;
+}
+
+template <typename Table>
+void load_native_csv(ExpConfig &config, std::string &text, Table &table) {
+    int n_cols = config.data_col_names.size() + 1;
+
+    // skip the header line if there is one
+    size_t text_len = text.size();
+    size_t begin_offset = 0;
+    if (text_len > 0 && text[0] != '-' && static_cast<unsigned char>(text[0] - '0') > 9) {
+        size_t header_end = text.find('\n');
+        begin_offset = header_end == std::string::npos ? text_len : header_end + 1;
+    }
+    text.append(CSV_PADDING, '\0');
+    const char *begin = text.data() + begin_offset;
+    const char *end = text.data() + text_len;
+
+    // split into chunks and move every chunk start forward to the next line start,
+    // so each thread parses whole lines only
+    int n_chunks = 4 * config.num_threads;
+    std::vector<const char *> chunk_begins(n_chunks + 1);
+    chunk_begins[0] = begin;
+    for (int chunk_idx = 1; chunk_idx < n_chunks; chunk_idx++) {
+        const char *p = std::max(begin + (end - begin) * chunk_idx / n_chunks, chunk_begins[chunk_idx - 1]);
+        if (p > begin && p < end && p[-1] != '\n') {
+            const char *line_end = static_cast<const char *>(std::memchr(p, '\n', end - p));
+            p = line_end == nullptr ? end : line_end + 1;
+        }
+        chunk_begins[chunk_idx] = p;
+    }
+    chunk_begins[n_chunks] = end;
+
+    // pass 1: rows per chunk, prefix summed into each chunk's first row
+    std::vector<int64_t> chunk_row_offsets(n_chunks + 1, 0);
+    omp_set_num_threads(config.num_threads);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int chunk_idx = 0; chunk_idx < n_chunks; chunk_idx++) {
+        chunk_row_offsets[chunk_idx + 1] = count_newlines(chunk_begins[chunk_idx], chunk_begins[chunk_idx + 1]);
+    }
+    if (begin < end && end[-1] != '\n') {
+        // last line without trailing newline, it belongs to the last non-empty chunk
+        int last_chunk = n_chunks - 1;
+        while (chunk_begins[last_chunk] >= end) {
+            last_chunk--;
+        }
+        chunk_row_offsets[last_chunk + 1] += 1;
+    }
+    for (int chunk_idx = 0; chunk_idx < n_chunks; chunk_idx++) {
+        chunk_row_offsets[chunk_idx + 1] += chunk_row_offsets[chunk_idx];
+    }
+    table.init_table(n_cols, chunk_row_offsets[n_chunks]);
+
+    // pass 2: parse each chunk into its rows of the table
+    std::atomic<bool> malformed(false);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int chunk_idx = 0; chunk_idx < n_chunks; chunk_idx++) {
+        const char *p = chunk_begins[chunk_idx];
+        const char *chunk_end = chunk_begins[chunk_idx + 1];
+        int64_t r = chunk_row_offsets[chunk_idx];
+        while (p < chunk_end && r < chunk_row_offsets[chunk_idx + 1]) {
+            for (int c = 0; c < n_cols && p != nullptr; c++) {
+                int64_t value;
+                p = parse_int64(p, value);
+                if (p == nullptr) {
+                    break;
+                }
+                table.write_value(r, c, value);
+                if (c + 1 < n_cols) {
+                    p = (*p == ',') ? p + 1 : nullptr;
+                }
+            }
+            if (p == nullptr) {
+                malformed = true;
+                break;
+            }
+            p += (*p == '\r');
+            if (*p != '\n' && p < end) {
+                malformed = true;
+                break;
+            }
+            p++;
+            r++;
+        }
+        if (r != chunk_row_offsets[chunk_idx + 1]) {
+            malformed = true;
+        }
+    }
+    if (malformed) {
+        throw std::runtime_error("malformed csv in " + config.dataset_file_path + ", expected " + std::to_string(n_cols) + " integer columns per line");
+    }
+}
+
+template <typename Table>
+void load_native_csv(ExpConfig &config, Table &table) {
+    auto t_read_0 = std::chrono::steady_clock::now();
+    std::string text = read_text_file(config.dataset_file_path, config.num_threads);
+    auto t_read_1 = std::chrono::steady_clock::now();
+    size_t n_bytes = text.size();
+    load_native_csv(config, text, table);
+    auto t_parse_1 = std::chrono::steady_clock::now();
+
+    std::cout << "native csv: read " << n_bytes << " bytes in " << std::chrono::duration_cast<std::chrono::milliseconds>(t_read_1 - t_read_0).count() << "ms, ";
+    std::cout << "parsed in " << std::chrono::duration_cast<std::chrono::milliseconds>(t_parse_1 - t_read_1).count() << "ms" << std::endl;
+}
+
+template void load_native_csv<RowStore>(ExpConfig &config, RowStore &table);
+template void load_native_csv<ColumnStore>(ExpConfig &config, ColumnStore &table);
+template void load_native_csv<SegmentedStore>(ExpConfig &config, SegmentedStore &table);
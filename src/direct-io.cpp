@@ -0,0 +1,322 @@
+//! io_uring driven O_DIRECT reader, see direct-io.hpp
+//! talks to the kernel with raw syscalls and the ring layout from <linux/io_uring.h>, so no liburing needed
+
+#include "direct-io.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#endif
+
+static inline uint64_t align_down(uint64_t x) {
+    return x & ~(static_cast<uint64_t>(DIRECT_IO_ALIGNMENT) - 1);
+}
+
+static inline uint64_t align_up(uint64_t x) {
+    return align_down(x + DIRECT_IO_ALIGNMENT - 1);
+}
+
+DirectFileReader::DirectFileReader(const std::string &path, int queue_depth) : path(path), queue_depth(std::max(1, queue_depth)) {
+#if defined(__linux__)
+    fd = open(path.c_str(), O_RDONLY | O_DIRECT);
+    direct = fd >= 0;
+    if (!direct) {
+        fd = open(path.c_str(), O_RDONLY);
+    }
+#else
+    // no O_DIRECT on macos, F_NOCACHE is the closest thing
+    fd = open(path.c_str(), O_RDONLY);
+    direct = fd >= 0 && fcntl(fd, F_NOCACHE, 1) == 0;
+#endif
+    if (fd < 0) {
+        throw std::runtime_error("cannot open " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("cannot stat " + path);
+    }
+    size = st.st_size;
+
+    if (!setup_ring(this->queue_depth)) {
+        ring_fd = -1;
+    }
+}
+
+DirectFileReader::~DirectFileReader() {
+    if (sqes != nullptr) {
+        munmap(sqes, sqes_size);
+    }
+    if (cq_ring != nullptr && cq_ring != sq_ring) {
+        munmap(cq_ring, cq_ring_size);
+    }
+    if (sq_ring != nullptr) {
+        munmap(sq_ring, sq_ring_size);
+    }
+    if (ring_fd >= 0) {
+        close(ring_fd);
+    }
+    close(fd);
+}
+
+bool DirectFileReader::setup_ring(unsigned entries) {
+#if !defined(__linux__)
+    return false;
+#else
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    ring_fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (ring_fd < 0) {
+        return false;
+    }
+    sq_entries = params.sq_entries;
+
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+    }
+    sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED) {
+        sq_ring = nullptr;
+        close(ring_fd);
+        return false;
+    }
+    cq_ring = single_mmap ? sq_ring : mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (cq_ring == MAP_FAILED || sqes == MAP_FAILED) {
+        // give back whatever did get mapped and fall back to pread
+        if (sqes != MAP_FAILED) {
+            munmap(sqes, sqes_size);
+        }
+        if (cq_ring != MAP_FAILED && cq_ring != sq_ring) {
+            munmap(cq_ring, cq_ring_size);
+        }
+        munmap(sq_ring, sq_ring_size);
+        sq_ring = cq_ring = sqes = nullptr;
+        close(ring_fd);
+        ring_fd = -1;
+        return false;
+    }
+
+    char *sq = static_cast<char *>(sq_ring);
+    char *cq = static_cast<char *>(cq_ring);
+    sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes = cq + params.cq_off.cqes;
+    return true;
+#endif
+}
+
+// finish a short read (or do the whole read, n_done == 0) with blocking preads
+void DirectFileReader::read_rest_sync(char *buffer, uint64_t aligned_offset, size_t n_done, size_t n_needed) {
+    while (n_done < n_needed) {
+        // keep offset and length aligned for O_DIRECT, the tail may run past the end of the file
+        size_t n_to_read = align_up(n_needed) - n_done;
+        ssize_t n = pread(fd, buffer + n_done, n_to_read, aligned_offset + n_done);
+        if (n <= 0) {
+            throw std::runtime_error("failed reading " + path + ": " + (n < 0 ? std::strerror(errno) : "unexpected end of file"));
+        }
+        n_done += n;
+    }
+}
+
+// size the slot's bounce buffers for its ranges, widened to aligned boundaries
+void DirectFileReader::prepare_slot(Slot &slot) {
+    slot.buffers.resize(slot.ranges.size(), nullptr);
+    slot.buffer_sizes.resize(slot.ranges.size(), 0);
+    slot.data.resize(slot.ranges.size());
+    for (size_t range_idx = 0; range_idx < slot.ranges.size(); range_idx++) {
+        const DirectReadRange &range = slot.ranges[range_idx];
+        size_t needed = align_up(range.offset + range.len) - align_down(range.offset);
+        if (slot.buffer_sizes[range_idx] < needed) {
+            std::free(slot.buffers[range_idx]);
+            slot.buffers[range_idx] = static_cast<char *>(std::aligned_alloc(DIRECT_IO_ALIGNMENT, needed));
+            if (slot.buffers[range_idx] == nullptr) {
+                throw std::runtime_error("cannot allocate read buffers");
+            }
+            slot.buffer_sizes[range_idx] = needed;
+        }
+        slot.data[range_idx] = slot.buffers[range_idx] + (range.offset - align_down(range.offset));
+    }
+}
+
+void DirectFileReader::read(DirectReadRange range, char *dst) {
+    Slot slot;
+    slot.ranges = {range};
+    prepare_slot(slot);
+    read_rest_sync(slot.buffers[0], align_down(range.offset), 0, range.offset + range.len - align_down(range.offset));
+    std::memcpy(dst, slot.data[0], range.len);
+    std::free(slot.buffers[0]);
+}
+
+void DirectFileReader::read_groups(
+    int64_t n_groups,
+    const std::function<void(int64_t group_idx, std::vector<DirectReadRange> &ranges)> &group_ranges,
+    const std::function<void(int64_t group_idx, const std::vector<const char *> &data)> &on_group
+) {
+    if (n_groups == 0) {
+        return;
+    }
+
+    // first group tells us how many reads a group takes, so we know how many groups fit in the queue
+    std::vector<DirectReadRange> first_ranges;
+    group_ranges(0, first_ranges);
+    size_t ranges_per_group = std::max<size_t>(1, first_ranges.size());
+    int n_slots = is_async() ? std::max<int>(1, std::min<int64_t>(std::min<unsigned>(queue_depth, sq_entries) / ranges_per_group, n_groups)) : 1;
+    if (is_async() && ranges_per_group > sq_entries) {
+        throw std::runtime_error("--io_queue_depth must be at least the number of reads per group (" + std::to_string(ranges_per_group) + ")");
+    }
+    std::vector<Slot> slots(n_slots);
+
+    auto free_slots = [&]() {
+        for (auto &slot : slots) {
+            for (char *buffer : slot.buffers) {
+                std::free(buffer);
+            }
+        }
+    };
+
+    try {
+        if (!is_async()) {
+            Slot &slot = slots[0];
+            for (int64_t group_idx = 0; group_idx < n_groups; group_idx++) {
+                slot.ranges.clear();
+                group_ranges(group_idx, slot.ranges);
+                prepare_slot(slot);
+                for (size_t range_idx = 0; range_idx < slot.ranges.size(); range_idx++) {
+                    const DirectReadRange &range = slot.ranges[range_idx];
+                    read_rest_sync(slot.buffers[range_idx], align_down(range.offset), 0, range.offset + range.len - align_down(range.offset));
+                }
+                on_group(group_idx, slot.data);
+            }
+            free_slots();
+            return;
+        }
+
+#if defined(__linux__)
+        auto *sqe_array = static_cast<io_uring_sqe *>(sqes);
+        auto *cqe_array = static_cast<io_uring_cqe *>(cqes);
+        std::vector<int> idle_slots;
+        for (int slot_idx = n_slots - 1; slot_idx >= 0; slot_idx--) {
+            idle_slots.push_back(slot_idx);
+        }
+
+        // wait for completions, calling on_cqe for each, until at least min_complete were reaped
+        unsigned n_unsubmitted = 0;
+        unsigned n_in_flight = 0;
+        auto reap = [&](unsigned min_complete, const std::function<void(const io_uring_cqe &)> &on_cqe) {
+            int ret;
+            do {
+                ret = syscall(__NR_io_uring_enter, ring_fd, n_unsubmitted, min_complete, IORING_ENTER_GETEVENTS, nullptr, 0);
+            } while (ret < 0 && errno == EINTR);
+            if (ret < 0) {
+                throw std::runtime_error(std::string("io_uring_enter failed: ") + std::strerror(errno));
+            }
+            n_unsubmitted -= ret;
+
+            unsigned head = *cq_head;
+            unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+            for (; head != tail; head++) {
+                io_uring_cqe cqe = cqe_array[head & *cq_mask];
+                __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+                n_in_flight--;
+                on_cqe(cqe);
+            }
+        };
+
+        try {
+            int64_t next_group_idx = 0;
+            int64_t n_groups_done = 0;
+            while (n_groups_done < n_groups) {
+                // === queue reads for as many groups as there are idle slots ===
+                while (!idle_slots.empty() && next_group_idx < n_groups) {
+                    int slot_idx = idle_slots.back();
+                    idle_slots.pop_back();
+                    Slot &slot = slots[slot_idx];
+                    slot.group_idx = next_group_idx++;
+                    slot.ranges.clear();
+                    if (slot.group_idx == 0) {
+                        slot.ranges = first_ranges;
+                    } else {
+                        group_ranges(slot.group_idx, slot.ranges);
+                    }
+                    prepare_slot(slot);
+                    slot.n_pending = slot.ranges.size();
+                    if (slot.ranges.empty()) {
+                        on_group(slot.group_idx, slot.data);
+                        n_groups_done++;
+                        idle_slots.push_back(slot_idx);
+                        continue;
+                    }
+
+                    for (size_t range_idx = 0; range_idx < slot.ranges.size(); range_idx++) {
+                        const DirectReadRange &range = slot.ranges[range_idx];
+                        unsigned tail = *sq_tail;
+                        unsigned sqe_idx = tail & *sq_mask;
+                        io_uring_sqe *sqe = &sqe_array[sqe_idx];
+                        std::memset(sqe, 0, sizeof(*sqe));
+                        sqe->opcode = IORING_OP_READ;
+                        sqe->fd = fd;
+                        sqe->addr = reinterpret_cast<uint64_t>(slot.buffers[range_idx]);
+                        sqe->len = align_up(range.offset + range.len) - align_down(range.offset);
+                        sqe->off = align_down(range.offset);
+                        sqe->user_data = (static_cast<uint64_t>(slot_idx) << 32) | range_idx;
+                        sq_array[sqe_idx] = sqe_idx;
+                        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+                        n_unsubmitted++;
+                        n_in_flight++;
+                    }
+                }
+                if (n_in_flight == 0) {
+                    continue;
+                }
+
+                // === submit, wait for at least one completion, hand on every group whose reads are all in ===
+                reap(1, [&](const io_uring_cqe &cqe) {
+                    int slot_idx = cqe.user_data >> 32;
+                    size_t range_idx = cqe.user_data & 0xFFFFFFFF;
+                    Slot &slot = slots[slot_idx];
+                    const DirectReadRange &range = slot.ranges[range_idx];
+                    if (cqe.res < 0) {
+                        throw std::runtime_error("failed reading " + path + ": " + std::strerror(-cqe.res));
+                    }
+                    size_t n_needed = range.offset + range.len - align_down(range.offset);
+                    read_rest_sync(slot.buffers[range_idx], align_down(range.offset), cqe.res, n_needed);
+
+                    if (--slot.n_pending == 0) {
+                        on_group(slot.group_idx, slot.data);
+                        n_groups_done++;
+                        idle_slots.push_back(slot_idx);
+                    }
+                });
+            }
+        } catch (...) {
+            // reads still in flight target the slot buffers, let them land before the buffers are freed
+            while (n_in_flight > 0) {
+                reap(1, [](const io_uring_cqe &) {});
+            }
+            throw;
+        }
+#endif
+    } catch (...) {
+        free_slots();
+        throw;
+    }
+    free_slots();
+}
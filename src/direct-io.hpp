@@ -0,0 +1,81 @@
+#pragma once
+
+//! asynchronous direct reads for binary dataset scans (--io_engine uring): O_DIRECT reads through io_uring
+//! with up to queue_depth requests in flight, so a scan keeps the device queue deep instead of faulting pages
+//! in one at a time. falls back to plain pread when io_uring is unavailable (old kernel, seccomp'd container)
+//! and to buffered reads when the filesystem refuses O_DIRECT (e.g. tmpfs)
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// O_DIRECT offsets, lengths and buffers must be multiples of the logical block size, 4K covers every device we use
+const size_t DIRECT_IO_ALIGNMENT = 4096;
+
+// one byte range of the file, any offset and length, read through an aligned bounce buffer
+struct DirectReadRange {
+    uint64_t offset;
+    uint64_t len;
+};
+
+class DirectFileReader {
+public:
+    DirectFileReader(const std::string &path, int queue_depth);
+    ~DirectFileReader();
+    DirectFileReader(const DirectFileReader &) = delete;
+    DirectFileReader &operator=(const DirectFileReader &) = delete;
+
+    uint64_t file_size() const { return size; }
+    bool is_async() const { return ring_fd >= 0; }
+    bool is_direct() const { return direct; }
+
+    // read a single range synchronously into dst
+    void read(DirectReadRange range, char *dst);
+
+    // read n_groups groups of ranges (e.g. the same rows of every column), filled in by group_ranges,
+    // keeping up to queue_depth reads in flight. on_group gets a pointer to each range's bytes once the whole
+    // group is in; groups complete in any order and the pointers are only valid during the call
+    void read_groups(
+        int64_t n_groups,
+        const std::function<void(int64_t group_idx, std::vector<DirectReadRange> &ranges)> &group_ranges,
+        const std::function<void(int64_t group_idx, const std::vector<const char *> &data)> &on_group
+    );
+
+private:
+    struct Slot {
+        int64_t group_idx = -1;
+        int n_pending = 0;
+        std::vector<DirectReadRange> ranges;
+        std::vector<char *> buffers; // aligned, buffer_sizes[i] bytes each
+        std::vector<size_t> buffer_sizes;
+        std::vector<const char *> data; // where ranges[i] starts inside buffers[i]
+    };
+
+    std::string path;
+    int fd = -1;
+    bool direct = false;
+    uint64_t size = 0;
+    int queue_depth;
+
+    // io_uring state, set up with raw syscalls, ring_fd < 0 means we use pread
+    int ring_fd = -1;
+    void *sq_ring = nullptr;
+    void *cq_ring = nullptr;
+    size_t sq_ring_size = 0;
+    size_t cq_ring_size = 0;
+    void *sqes = nullptr;
+    size_t sqes_size = 0;
+    unsigned sq_entries = 0;
+    unsigned *sq_tail = nullptr;
+    unsigned *sq_mask = nullptr;
+    unsigned *sq_array = nullptr;
+    unsigned *cq_head = nullptr;
+    unsigned *cq_tail = nullptr;
+    unsigned *cq_mask = nullptr;
+    void *cqes = nullptr;
+
+    bool setup_ring(unsigned entries);
+    void prepare_slot(Slot &slot);
+    void read_rest_sync(char *buffer, uint64_t aligned_offset, size_t n_done, size_t n_needed);
+};
@@ -6,6 +6,9 @@
  * @date April 19, 2025
  */
 
+ #include <cerrno>
+ #include <cstdlib>
+ #include <cstring>
  #include <regex>
  #include <random>
  
@@ -14,30 +17,58 @@
  #include <CLI11.hpp>
  #include <indicators.hpp>
  
+ #include "gzip-index.hpp"
+ 
  const int SEED = 42;
  
  /**
-  * @brief Flush the cached output to a gzip file safely.
+  * @brief Flush the cached output to the dataset file as its own gzip member.
   *
-  * Writes the stringstream (oss) to the gzip file (file) inside an OpenMP critical section,
-  * updates the progress bar (bar), then clears the cache (oss) and resets cache_size.
+  * Compresses the stringstream (oss) into an independent gzip member outside of any lock, so
+  * threads compress in parallel. Then, inside an OpenMP critical section, appends the member to
+  * the file (file), records it in the member index (members), and updates the progress bar (bar).
+  * Finally clears the cache (oss) and resets cache_size.
   *
-  * @param file Gzip file handle.
+  * @param file Output file handle.
+  * @param members Index of gzip members written so far.
   * @param oss  Output stringstream holding buffered data.
   * @param bar  Progress bar to update.
   * @param p    Progress counter (number of rows written).
   * @param cache_size Number of rows currently in cache.
   */
- #define FLUSH_CACHE(file, oss, bar, p, cache_size)     \
-     _Pragma("omp critical")                            \
-     {                                                  \
-         std::string buffer = (oss).str();              \
-         gzwrite((file), buffer.data(), buffer.size()); \
-         (bar).set_progress((p) += (cache_size));       \
-     }                                                  \
-     (oss).str(std::string());                          \
-     (oss).clear();                                     \
-     (cache_size) = 0;                                  \
+ #define FLUSH_CACHE(file, members, oss, bar, p, cache_size) \
+     {                                                      \
+         std::string buffer = (oss).str();                  \
+         std::string member = gzip_compress_member(buffer); \
+         _Pragma("omp critical")                            \
+         {                                                  \
+             append_member((file), (members), member, buffer.size()); \
+             (bar).set_progress((p) += (cache_size));       \
+         }                                                  \
+     }                                                      \
+     (oss).str(std::string());                              \
+     (oss).clear();                                         \
+     (cache_size) = 0;                                      \
+ 
+ /**
+  * @brief Append a compressed gzip member to the output file and record it in the index.
+  *
+  * @param file    Output file handle.
+  * @param members Index of gzip members written so far.
+  * @param member  Compressed gzip member.
+  * @param uncompressed_size Size of the member's data before compression.
+  */
+ void append_member(FILE *file, std::vector<GzipMemberEntry> &members, const std::string &member, size_t uncompressed_size)
+ {
+     uint64_t offset = members.empty() ? 0 : members.back().compressed_offset + members.back().compressed_size;
+     if (fwrite(member.data(), 1, member.size(), file) != member.size())
+     {
+         // called from inside the parallel region, so there is no caller to hand the error back to
+         std::cerr << "Error: Failed writing gzip member at offset " << offset << ": " << std::strerror(errno) << "\n";
+         std::exit(1);
+     }
+     members.push_back(GzipMemberEntry{offset, member.size(), uncompressed_size});
+ }
  
  /**
   * @brief Parse a string representing an integer count with an optional suffix (K, M, B, T).
@@ -154,19 +185,21 @@
      };
  
      /**
-      * Open the gzip file for writing
+      * Open the output file for writing, it is filled with independently compressed gzip members
       */
-     gzFile file = gzopen(path.c_str(), "wb");
+     FILE *file = fopen(path.c_str(), "wb");
      if (file == nullptr)
      {
          std::cerr << "Error: Failed to open " << path << " for gzip writing.\n";
          return 1;
      }
+     std::vector<GzipMemberEntry> members;
  
      /**
       * Write CSV header
       */
-     gzprintf(file, "key,val\n");
+     std::string header = "key,val\n";
+     append_member(file, members, gzip_compress_member(header), header.size());
  
      /**
       * Run the sampling in parallel
@@ -191,9 +224,9 @@
                  int64_t key = key_distribution(gen);
                  int16_t val = val_distribution(gen);
                  oss << key << "," << val << "\n";
-                 if (++cache_size >= batch_size) { FLUSH_CACHE(file, oss, bar, p, cache_size); }
+                 if (++cache_size >= batch_size) { FLUSH_CACHE(file, members, oss, bar, p, cache_size); }
              }
-             if (cache_size > 0) { FLUSH_CACHE(file, oss, bar, p, cache_size); }
+             if (cache_size > 0) { FLUSH_CACHE(file, members, oss, bar, p, cache_size); }
  
              // Ensure each group has at least one row
              #pragma omp for
@@ -202,9 +235,9 @@
                  int64_t key = i;
                  int16_t val = val_distribution(gen);
                  oss << key << "," << val << "\n";
-                 if (++cache_size >= batch_size) { FLUSH_CACHE(file, oss, bar, p, cache_size); }
+                 if (++cache_size >= batch_size) { FLUSH_CACHE(file, members, oss, bar, p, cache_size); }
              }
-             if (cache_size > 0) { FLUSH_CACHE(file, oss, bar, p, cache_size); }
+             if (cache_size > 0) { FLUSH_CACHE(file, members, oss, bar, p, cache_size); }
  
          }
      }
@@ -226,9 +259,9 @@
                  do { key = static_cast<size_t>(std::llround(key_distribution(gen))); } while (key >= num_groups); 
                  int16_t val = val_distribution(gen);
                  oss << key << "," << val << "\n";
-                 if (++cache_size >= batch_size) { FLUSH_CACHE(file, oss, bar, p, cache_size); }
+                 if (++cache_size >= batch_size) { FLUSH_CACHE(file, members, oss, bar, p, cache_size); }
              }
-             if (cache_size > 0) { FLUSH_CACHE(file, oss, bar, p, cache_size); }
+             if (cache_size > 0) { FLUSH_CACHE(file, members, oss, bar, p, cache_size); }
              
              // Ensure each group has at least one row
              #pragma omp for
@@ -237,9 +270,9 @@
                  int64_t key = i;
                  int16_t val = val_distribution(gen);
                  oss << key << "," << val << "\n";
-                 if (++cache_size >= batch_size) { FLUSH_CACHE(file, oss, bar, p, cache_size); }
+                 if (++cache_size >= batch_size) { FLUSH_CACHE(file, members, oss, bar, p, cache_size); }
              }
-             if (cache_size > 0) { FLUSH_CACHE(file, oss, bar, p, cache_size); }
+             if (cache_size > 0) { FLUSH_CACHE(file, members, oss, bar, p, cache_size); }
          }
      }
      else if (distribution == "exponential")
@@ -260,9 +293,9 @@
                  do { key = static_cast<size_t>(key_distribution(gen)); } while (key >= num_groups);
                  int16_t val = val_distribution(gen);
                  oss << key << "," << val << "\n";
-                 if (++cache_size >= batch_size) { FLUSH_CACHE(file, oss, bar, p, cache_size); }
+                 if (++cache_size >= batch_size) { FLUSH_CACHE(file, members, oss, bar, p, cache_size); }
              }
-             if (cache_size > 0) { FLUSH_CACHE(file, oss, bar, p, cache_size); }
+             if (cache_size > 0) { FLUSH_CACHE(file, members, oss, bar, p, cache_size); }
              
              // Ensure each group has at least one row
              #pragma omp for
@@ -271,9 +304,9 @@
                  size_t key = i;
                  int16_t val = val_distribution(gen);
                  oss << key << "," << val << "\n";
-                 if (++cache_size >= batch_size) { FLUSH_CACHE(file, oss, bar, p, cache_size); }
+                 if (++cache_size >= batch_size) { FLUSH_CACHE(file, members, oss, bar, p, cache_size); }
              }
-             if (cache_size > 0) { FLUSH_CACHE(file, oss, bar, p, cache_size); }
+             if (cache_size > 0) { FLUSH_CACHE(file, members, oss, bar, p, cache_size); }
  
          }
      }
@@ -303,9 +336,9 @@
                  }
                  int16_t val = val_distribution(gen);
                  oss << key << "," << val << "\n";
-                 if (++cache_size >= batch_size) { FLUSH_CACHE(file, oss, bar, p, cache_size); }
+                 if (++cache_size >= batch_size) { FLUSH_CACHE(file, members, oss, bar, p, cache_size); }
              }
-             if (cache_size > 0) { FLUSH_CACHE(file, oss, bar, p, cache_size); }
+             if (cache_size > 0) { FLUSH_CACHE(file, members, oss, bar, p, cache_size); }
              
              // Ensure each group has at least one row
              #pragma omp for
@@ -314,9 +347,9 @@
                  size_t key = i;
                  int16_t val = val_distribution(gen);
                  oss << key << "," << val << "\n";
-                 if (++cache_size >= batch_size) { FLUSH_CACHE(file, oss, bar, p, cache_size); }
+                 if (++cache_size >= batch_size) { FLUSH_CACHE(file, members, oss, bar, p, cache_size); }
              }
-             if (cache_size > 0) { FLUSH_CACHE(file, oss, bar, p, cache_size); }
+             if (cache_size > 0) { FLUSH_CACHE(file, members, oss, bar, p, cache_size); }
  
          }
      }
@@ -346,9 +379,9 @@
                  size_t key = vec[i];
                  int16_t val = val_distribution(gen);
                  oss << key << "," << val << "\n";
-                 if (++cache_size >= batch_size) { FLUSH_CACHE(file, oss, bar, p, cache_size); }
+                 if (++cache_size >= batch_size) { FLUSH_CACHE(file, members, oss, bar, p, cache_size); }
              }
-             if (cache_size > 0) { FLUSH_CACHE(file, oss, bar, p, cache_size); }
+             if (cache_size > 0) { FLUSH_CACHE(file, members, oss, bar, p, cache_size); }
  
              // 20M-40M: UNIFORM (0-200K)
              std::uniform_int_distribution<int64_t> key_distribution1(0, 20);
@@ -358,9 +391,9 @@
                  int64_t key = key_distribution1(gen);
                  int16_t val = val_distribution(gen);
                  oss << key << "," << val << "\n";
-                 if (++cache_size >= batch_size) { FLUSH_CACHE(file, oss, bar, p, cache_size); }
+                 if (++cache_size >= batch_size) { FLUSH_CACHE(file, members, oss, bar, p, cache_size); }
              }
-             if (cache_size > 0) { FLUSH_CACHE(file, oss, bar, p, cache_size); }
+             if (cache_size > 0) { FLUSH_CACHE(file, members, oss, bar, p, cache_size); }
  
              // 40M-60M: UNIFORM (0-20K)
              std::uniform_int_distribution<int64_t> key_distribution2(0, 2000000);
@@ -370,9 +403,9 @@
                  int64_t key = key_distribution2(gen);
                  int16_t val = val_distribution(gen);
                  oss << key << "," << val << "\n";
-                 if (++cache_size >= batch_size) { FLUSH_CACHE(file, oss, bar, p, cache_size); }
+                 if (++cache_size >= batch_size) { FLUSH_CACHE(file, members, oss, bar, p, cache_size); }
              }
-             if (cache_size > 0) { FLUSH_CACHE(file, oss, bar, p, cache_size); }
+             if (cache_size > 0) { FLUSH_CACHE(file, members, oss, bar, p, cache_size); }
  
              // 60M-80M: UNIFROM (0-2K)
              std::uniform_int_distribution<int64_t> key_distribution3(0, 20);
@@ -382,14 +415,20 @@
                  int64_t key = key_distribution3(gen);
                  int16_t val = val_distribution(gen);
                  oss << key << "," << val << "\n";
-                 if (++cache_size >= batch_size) { FLUSH_CACHE(file, oss, bar, p, cache_size); }
+                 if (++cache_size >= batch_size) { FLUSH_CACHE(file, members, oss, bar, p, cache_size); }
              }
-             if (cache_size > 0) { FLUSH_CACHE(file, oss, bar, p, cache_size); }
+             if (cache_size > 0) { FLUSH_CACHE(file, members, oss, bar, p, cache_size); }
          }
      }
  
      /**
-      * Close the gzip file
+      * Close the file and write the sidecar member index used for parallel decompression
       */
-     gzclose(file);
+     if (fclose(file) != 0)
+     {
+         std::cerr << "Error: Failed writing " << path << ": " << std::strerror(errno) << "\n";
+         return 1;
+     }
+     write_gzip_index(path, members);
+     std::cout << "Wrote " << members.size() << " gzip members, index at " << gzip_index_path(path) << "\n";
  }
\ No newline at end of file
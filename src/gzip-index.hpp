@@ -0,0 +1,89 @@
+#pragma once
+
+//! multi-member gzip datasets: generate.cpp writes every flushed batch of rows as its own gzip member
+//! (a concatenation of members is still one valid .gz file), plus a sidecar <path>.idx listing where each
+//! member starts, so loaders can inflate all members in parallel instead of one serial stream
+
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+const uint64_t GZIP_INDEX_MAGIC = 0x58495a4742594250; // "PBYBGZIX"
+
+struct GzipMemberEntry {
+    uint64_t compressed_offset; // byte offset of the member in the .gz file
+    uint64_t compressed_size;
+    uint64_t uncompressed_size;
+};
+
+inline std::string gzip_index_path(const std::string &gz_path) {
+    return gz_path + ".idx";
+}
+
+// compress data into one self-contained gzip member
+inline std::string gzip_compress_member(const std::string &data, int level = Z_DEFAULT_COMPRESSION) {
+    z_stream strm{};
+    if (deflateInit2(&strm, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw std::runtime_error("deflateInit2 failed");
+    }
+    std::string out(deflateBound(&strm, data.size()), '\0');
+    strm.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+    strm.avail_in = data.size();
+    strm.next_out = reinterpret_cast<Bytef *>(&out[0]);
+    strm.avail_out = out.size();
+    int ret = deflate(&strm, Z_FINISH);
+    deflateEnd(&strm);
+    if (ret != Z_STREAM_END) {
+        throw std::runtime_error("deflate failed");
+    }
+    out.resize(strm.total_out);
+    return out;
+}
+
+// inflate one gzip member into dst, which must hold exactly uncompressed_size bytes
+inline bool gzip_decompress_member(const char *src, size_t src_size, char *dst, size_t dst_size) {
+    z_stream strm{};
+    if (inflateInit2(&strm, 15 + 16) != Z_OK) {
+        return false;
+    }
+    strm.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(src));
+    strm.avail_in = src_size;
+    strm.next_out = reinterpret_cast<Bytef *>(dst);
+    strm.avail_out = dst_size;
+    int ret = inflate(&strm, Z_FINISH);
+    bool ok = (ret == Z_STREAM_END && strm.total_out == dst_size);
+    inflateEnd(&strm);
+    return ok;
+}
+
+inline void write_gzip_index(const std::string &gz_path, const std::vector<GzipMemberEntry> &members) {
+    std::ofstream out(gzip_index_path(gz_path), std::ios::binary | std::ios::trunc);
+    uint64_t n_members = members.size();
+    out.write(reinterpret_cast<const char *>(&GZIP_INDEX_MAGIC), sizeof(GZIP_INDEX_MAGIC));
+    out.write(reinterpret_cast<const char *>(&n_members), sizeof(n_members));
+    out.write(reinterpret_cast<const char *>(members.data()), sizeof(GzipMemberEntry) * n_members);
+    if (!out) {
+        throw std::runtime_error("failed writing " + gzip_index_path(gz_path));
+    }
+}
+
+// returns false if there is no (valid) index next to gz_path
+inline bool read_gzip_index(const std::string &gz_path, std::vector<GzipMemberEntry> &members) {
+    std::ifstream in(gzip_index_path(gz_path), std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    uint64_t magic = 0;
+    uint64_t n_members = 0;
+    in.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+    in.read(reinterpret_cast<char *>(&n_members), sizeof(n_members));
+    if (!in || magic != GZIP_INDEX_MAGIC) {
+        return false;
+    }
+    members.resize(n_members);
+    in.read(reinterpret_cast<char *>(members.data()), sizeof(GzipMemberEntry) * n_members);
+    return static_cast<bool>(in);
+}
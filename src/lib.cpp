@@ -1,35 +1,483 @@
+#include "direct-io.hpp"
 #include "lib.hpp"
+#include <atomic>
+#include <cassert>
 #include <cmath>
 #include <duckdb.hpp>
+#include <exception>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
 #include <iostream>
 #include <omp.h>
 #include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <type_traits>
+#include <unistd.h>
 
-void load_data(ExpConfig &config, RowStore &table) {
+template <typename Table>
+static void load_duckdb_data(ExpConfig &config, Table &table) {
     duckdb::DuckDB db(nullptr);
     duckdb::Connection con(db);
     
-    auto duckdb_res = con.Query("select key, val from '" + config.dataset_file_path + "'");
+    // cast in the query so every column vector holds plain int64_t we can copy directly
+    auto duckdb_res = con.Query("select key::BIGINT as key, val::BIGINT as val from '" + config.dataset_file_path + "'");
+    if (duckdb_res->HasError()) {
+        throw std::runtime_error(duckdb_res->GetError());
+    }
 
     int n_cols = config.data_col_names.size() + 1;
     table.init_table(n_cols, duckdb_res->RowCount());
     
-    // go through all chunks
-    int r = 0;
-    while (auto chunk = duckdb_res->Fetch()) {
-        // go through each col i in the chunk
-        for (duckdb::idx_t r_in_chunk = 0; r_in_chunk < chunk->size(); r_in_chunk++) {
-            for (duckdb::idx_t c = 0; c < n_cols; c++) {
-                table.write_value(r, c, chunk->GetValue(c, r_in_chunk).GetValue<int64_t>());
+    // fetch chunks a batch at a time, record where each chunk starts in the table,
+    // then copy the batch's column vectors into the table in parallel
+    const size_t chunks_per_batch = 16 * config.num_threads;
+    std::vector<std::unique_ptr<duckdb::DataChunk>> chunks;
+    std::vector<int64_t> chunk_row_offsets;
+    chunks.reserve(chunks_per_batch);
+    chunk_row_offsets.reserve(chunks_per_batch);
+    
+    omp_set_num_threads(config.num_threads);
+    int64_t r = 0;
+    bool done = false;
+    while (!done) {
+        chunks.clear();
+        chunk_row_offsets.clear();
+        while (chunks.size() < chunks_per_batch) {
+            auto chunk = duckdb_res->Fetch();
+            if (!chunk || chunk->size() == 0) {
+                done = true;
+                break;
+            }
+            chunk->Flatten();
+            chunk_row_offsets.push_back(r);
+            r += chunk->size();
+            chunks.push_back(std::move(chunk));
+        }
+        
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (size_t chunk_idx = 0; chunk_idx < chunks.size(); chunk_idx++) {
+            auto &chunk = chunks[chunk_idx];
+            for (int c = 0; c < n_cols; c++) {
+                const int64_t *col_data = duckdb::FlatVector::GetData<int64_t>(chunk->data[c]);
+                table.write_column_chunk(chunk_row_offsets[chunk_idx], c, col_data, chunk->size());
+            }
+        }
+    }
+    assert(r == table.n_rows);
+    
+    std::cout << "table.n_rows = " << table.n_rows << std::endl;
+    std::cout << "table.n_cols = " << table.n_cols << std::endl;
+}
+
+bool is_binary_dataset_path(const std::string &path) {
+    const std::string ext = ".bin";
+    return path.size() >= ext.size() && path.compare(path.size() - ext.size(), ext.size(), ext) == 0;
+}
+
+uint64_t compute_binary_checksum(ColumnStore &table) {
+    uint64_t checksum = 0;
+    for (int c = 0; c < table.n_cols; c++) {
+        checksum = XXH3_64bits_withSeed(&table.data[table.get_idx(0, c)], sizeof(int64_t) * table.n_rows, checksum);
+    }
+    return checksum;
+}
+
+void write_binary_dataset(const std::string &path, ColumnStore &table) {
+    assert(table.n_cols <= BINARY_DATASET_MAX_COLS);
+    
+    BinaryDatasetHeader header{};
+    header.magic = BINARY_DATASET_MAGIC;
+    header.version = BINARY_DATASET_VERSION;
+    header.n_cols = table.n_cols;
+    header.n_rows = table.n_rows;
+    for (int c = 0; c < table.n_cols; c++) {
+        header.col_types[c] = BINARY_COL_INT64;
+    }
+    header.checksum = compute_binary_checksum(table);
+    
+    // header is padded out to a full page so the column segments start page aligned
+    std::vector<char> header_page(BINARY_DATASET_HEADER_SIZE, 0);
+    std::memcpy(header_page.data(), &header, sizeof(header));
+    
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("cannot open " + path + " for writing");
+    }
+    out.write(header_page.data(), header_page.size());
+    out.write(reinterpret_cast<const char *>(table.data), sizeof(int64_t) * table.n_cols * table.n_rows);
+    if (!out) {
+        throw std::runtime_error("failed writing " + path);
+    }
+}
+
+static void validate_binary_header(const std::string &path, const BinaryDatasetHeader &header, size_t file_size) {
+    if (header.magic != BINARY_DATASET_MAGIC || header.version != BINARY_DATASET_VERSION) {
+        throw std::runtime_error(path + " is not a binary dataset of a supported version");
+    }
+    if (header.n_cols > BINARY_DATASET_MAX_COLS) {
+        throw std::runtime_error(path + " has more columns than a binary dataset can hold");
+    }
+    for (uint32_t c = 0; c < header.n_cols; c++) {
+        if (header.col_types[c] != BINARY_COL_INT64) {
+            throw std::runtime_error(path + " has a column type we cannot read");
+        }
+    }
+    // compared by division, so a corrupt n_rows cannot wrap the size computation
+    if (file_size < BINARY_DATASET_HEADER_SIZE || header.n_rows > (file_size - BINARY_DATASET_HEADER_SIZE) / (sizeof(int64_t) * std::max<uint32_t>(header.n_cols, 1))) {
+        throw std::runtime_error(path + " is truncated");
+    }
+}
+
+void map_binary_dataset(const std::string &path, ColumnStore &view, bool verify_checksum) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < BINARY_DATASET_HEADER_SIZE) {
+        close(fd);
+        throw std::runtime_error(path + " is too small to be a binary dataset");
+    }
+    size_t file_size = st.st_size;
+    
+    // mapping stays alive for the rest of the process, the view points straight into it
+    void *base = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        throw std::runtime_error("cannot mmap " + path);
+    }
+    
+    BinaryDatasetHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    try {
+        validate_binary_header(path, header, file_size);
+    } catch (...) {
+        munmap(base, file_size);
+        throw;
+    }
+    
+    int64_t *col_data = reinterpret_cast<int64_t *>(static_cast<char *>(base) + BINARY_DATASET_HEADER_SIZE);
+    view.init_view(header.n_cols, header.n_rows, col_data);
+    
+    if (verify_checksum && compute_binary_checksum(view) != header.checksum) {
+        munmap(base, file_size);
+        view.data = nullptr;
+        throw std::runtime_error(path + " failed checksum verification");
+    }
+}
+
+// scan a binary dataset with direct async reads, one group of reads per block of rows, a read per column,
+// on_rows gets the block's column pointers, blocks arrive in any order
+static void read_binary_dataset_direct(
+    ExpConfig &config,
+    int64_t rows_per_read,
+    const std::function<void(const BinaryDatasetHeader &header)> &on_header,
+    const std::function<void(int64_t row_lb, int64_t n, const std::vector<const int64_t *> &cols)> &on_rows
+) {
+    DirectFileReader reader(config.dataset_file_path, config.io_queue_depth);
+    BinaryDatasetHeader header;
+    if (reader.file_size() < BINARY_DATASET_HEADER_SIZE) {
+        throw std::runtime_error(config.dataset_file_path + " is too small to be a binary dataset");
+    }
+    reader.read(DirectReadRange{0, sizeof(header)}, reinterpret_cast<char *>(&header));
+    validate_binary_header(config.dataset_file_path, header, reader.file_size());
+    if (!reader.is_async() || !reader.is_direct()) {
+        std::cout << "io_engine uring: " << (reader.is_async() ? "" : "io_uring unavailable, using pread, ") << (reader.is_direct() ? "" : "O_DIRECT unsupported, using buffered reads") << std::endl;
+    }
+    on_header(header);
+    
+    int64_t n_rows = header.n_rows;
+    int64_t n_blocks = (n_rows + rows_per_read - 1) / rows_per_read;
+    std::vector<const int64_t *> cols(header.n_cols);
+    reader.read_groups(
+        n_blocks,
+        [&](int64_t block_idx, std::vector<DirectReadRange> &ranges) {
+            int64_t row_lb = block_idx * rows_per_read;
+            int64_t n = std::min(rows_per_read, n_rows - row_lb);
+            for (uint32_t c = 0; c < header.n_cols; c++) {
+                ranges.push_back(DirectReadRange{BINARY_DATASET_HEADER_SIZE + sizeof(int64_t) * (c * n_rows + row_lb), sizeof(int64_t) * n});
+            }
+        },
+        [&](int64_t block_idx, const std::vector<const char *> &data) {
+            int64_t row_lb = block_idx * rows_per_read;
+            for (uint32_t c = 0; c < header.n_cols; c++) {
+                // every range starts 8 byte aligned in its page aligned buffer, so this is a valid int64 array
+                cols[c] = reinterpret_cast<const int64_t *>(data[c]);
+            }
+            on_rows(row_lb, std::min(rows_per_read, n_rows - row_lb), cols);
+        }
+    );
+}
+
+void unmap_binary_dataset(ColumnStore &view) {
+    char *base = reinterpret_cast<char *>(view.data) - BINARY_DATASET_HEADER_SIZE;
+    munmap(base, BINARY_DATASET_HEADER_SIZE + sizeof(int64_t) * view.n_cols * view.n_rows);
+    view.data = nullptr;
+}
+
+// column store views the mapping directly, other layouts get filled from it in parallel
+// with --io_engine uring the file is read with direct async reads instead, bypassing the page cache
+template <typename Table>
+static void load_binary_data(ExpConfig &config, Table &table) {
+    if (config.io_engine == "uring") {
+        // the checksum is chained over whole columns and direct reads complete out of order, so it can only be
+        // checked on the loaded columns, reading the file a second time through the page cache defeats O_DIRECT
+        if (config.verify_checksum && !std::is_same_v<Table, ColumnStore>) {
+            throw std::runtime_error("--verify_checksum with --io_engine uring needs --layout column or packed");
+        }
+        uint64_t expected_checksum = 0;
+        read_binary_dataset_direct(
+            config,
+            DIRECT_IO_ROWS_PER_READ,
+            [&](const BinaryDatasetHeader &header) {
+                expected_checksum = header.checksum;
+                table.init_table(header.n_cols, header.n_rows);
+            },
+            [&](int64_t row_lb, int64_t n, const std::vector<const int64_t *> &cols) {
+                for (size_t c = 0; c < cols.size(); c++) {
+                    table.write_column_chunk(row_lb, c, cols[c], n);
+                }
+            }
+        );
+        if constexpr (std::is_same_v<Table, ColumnStore>) {
+            if (config.verify_checksum && compute_binary_checksum(table) != expected_checksum) {
+                throw std::runtime_error(config.dataset_file_path + " failed checksum verification");
+            }
+        }
+        std::cout << "table.n_rows = " << table.n_rows << std::endl;
+        std::cout << "table.n_cols = " << table.n_cols << std::endl;
+        return;
+    }
+    
+    ColumnStore view;
+    map_binary_dataset(config.dataset_file_path, view, config.verify_checksum);
+    
+    if constexpr (std::is_same_v<Table, ColumnStore>) {
+        table = view;
+    } else {
+        table.init_table(view.n_cols, view.n_rows);
+        const int64_t block_size = 1 << 16;
+        omp_set_num_threads(config.num_threads);
+        #pragma omp parallel for schedule(static)
+        for (int64_t row_lb = 0; row_lb < view.n_rows; row_lb += block_size) {
+            int64_t n = std::min(block_size, view.n_rows - row_lb);
+            for (int c = 0; c < view.n_cols; c++) {
+                table.write_column_chunk(row_lb, c, &view.data[view.get_idx(row_lb, c)], n);
+            }
+        }
+    }
+    
+    std::cout << "table.n_rows = " << table.n_rows << std::endl;
+    std::cout << "table.n_cols = " << table.n_cols << std::endl;
+}
+
+// every chunk is inflated by one thread, column store chunks straight into the table
+template <typename Table>
+static void load_compressed_data(ExpConfig &config, Table &table) {
+    CompressedDatasetView view;
+    map_compressed_dataset(config.dataset_file_path, view);
+    table.init_table(view.header.n_cols, view.header.n_rows);
+    
+    std::exception_ptr error = nullptr;
+    omp_set_num_threads(config.num_threads);
+    #pragma omp parallel
+    {
+        std::vector<int64_t> buffer(std::is_same_v<Table, ColumnStore> ? 0 : view.header.chunk_rows);
+        #pragma omp for schedule(dynamic, 1)
+        for (int64_t chunk_idx = 0; chunk_idx < static_cast<int64_t>(view.header.n_chunks); chunk_idx++) {
+            int64_t row_lb = view.chunk_row_lb(chunk_idx);
+            for (int c = 0; c < table.n_cols; c++) {
+                try {
+                    if constexpr (std::is_same_v<Table, ColumnStore>) {
+                        inflate_compressed_chunk(view, chunk_idx, c, &table.data[table.get_idx(row_lb, c)], config.verify_checksum);
+                    } else {
+                        inflate_compressed_chunk(view, chunk_idx, c, buffer.data(), config.verify_checksum);
+                        table.write_column_chunk(row_lb, c, buffer.data(), view.chunk_n_rows(chunk_idx));
+                    }
+                } catch (...) {
+                    #pragma omp critical
+                    error = std::current_exception();
+                }
             }
-            r++;
         }
     }
+    unmap_compressed_dataset(view);
+    if (error) {
+        std::rethrow_exception(error);
+    }
     
     std::cout << "table.n_rows = " << table.n_rows << std::endl;
     std::cout << "table.n_cols = " << table.n_cols << std::endl;
 }
 
+template <typename Table>
+void load_data(ExpConfig &config, Table &table) {
+    if constexpr (std::is_same_v<Table, PackedStore>) {
+        // packing needs each column's range up front, so load unpacked first and encode afterwards
+        ColumnStore unpacked;
+        load_data(config, unpacked);
+        table.pack_from(unpacked, config.num_threads);
+        if (unpacked.is_view) {
+            unmap_binary_dataset(unpacked);
+        } else {
+            delete[] unpacked.data;
+        }
+        std::cout << "packed widths = [";
+        for (const auto &col : table.columns) {
+            std::cout << col.width << ", ";
+        }
+        std::cout << "], " << table.packed_bytes() << " bytes packed vs " << sizeof(int64_t) * table.n_cols * table.n_rows << " unpacked" << std::endl;
+    } else if (is_binary_dataset_path(config.dataset_file_path)) {
+        load_binary_data(config, table);
+    } else if (is_compressed_dataset_path(config.dataset_file_path)) {
+        load_compressed_data(config, table);
+    } else if (config.loader == "native") {
+        load_native_csv(config, table);
+    } else {
+        load_duckdb_data(config, table);
+    }
+}
+
+template void load_data<RowStore>(ExpConfig &config, RowStore &table);
+template void load_data<ColumnStore>(ExpConfig &config, ColumnStore &table);
+template void load_data<SegmentedStore>(ExpConfig &config, SegmentedStore &table);
+template void load_data<PackedStore>(ExpConfig &config, PackedStore &table);
+
+// fills RowStore batches from column-wise data, handing batches on as they fill up
+// every producer thread of stream_batches owns one
+struct BatchAppender {
+    BoundedQueue<RowStore *> &free_batches;
+    BoundedQueue<RowStore *> &full_batches;
+    int64_t capacity;
+    RowStore *batch = nullptr;
+    
+    // append n rows of column-wise data to the current batch
+    void append_columns(const std::vector<const int64_t *> &cols, int64_t n) {
+        int64_t offset = 0;
+        while (offset < n) {
+            if (batch == nullptr) {
+                free_batches.pop(batch);
+                batch->n_rows = 0;
+            }
+            int64_t n_to_copy = std::min(n - offset, capacity - batch->n_rows);
+            for (size_t c = 0; c < cols.size(); c++) {
+                batch->write_column_chunk(batch->n_rows, c, cols[c] + offset, n_to_copy);
+            }
+            batch->n_rows += n_to_copy;
+            offset += n_to_copy;
+            if (batch->n_rows == capacity) {
+                flush();
+            }
+        }
+    }
+    
+    // hand on the partially filled batch, if any
+    void flush() {
+        if (batch != nullptr) {
+            full_batches.push(batch);
+            batch = nullptr;
+        }
+    }
+};
+
+// several threads take chunks in order and inflate them into their own batches,
+// so decompressing the next chunks overlaps with the workers aggregating the previous ones
+static void stream_compressed_batches(ExpConfig &config, BoundedQueue<RowStore *> &free_batches, BoundedQueue<RowStore *> &full_batches) {
+    CompressedDatasetView view;
+    map_compressed_dataset(config.dataset_file_path, view);
+    
+    std::atomic<int64_t> next_chunk_idx(0);
+    std::atomic<bool> failed(false);
+    std::vector<std::exception_ptr> errors(config.stream_decompress_threads);
+    std::vector<std::thread> decompressors;
+    for (int decompressor_idx = 0; decompressor_idx < config.stream_decompress_threads; decompressor_idx++) {
+        decompressors.emplace_back([&, decompressor_idx]() {
+            BatchAppender appender{free_batches, full_batches, config.stream_batch_rows};
+            std::vector<std::vector<int64_t>> buffers(view.header.n_cols, std::vector<int64_t>(view.header.chunk_rows));
+            std::vector<const int64_t *> cols(view.header.n_cols);
+            try {
+                int64_t chunk_idx;
+                while (!failed && (chunk_idx = next_chunk_idx++) < static_cast<int64_t>(view.header.n_chunks)) {
+                    for (uint32_t c = 0; c < view.header.n_cols; c++) {
+                        inflate_compressed_chunk(view, chunk_idx, c, buffers[c].data(), config.verify_checksum);
+                        cols[c] = buffers[c].data();
+                    }
+                    appender.append_columns(cols, view.chunk_n_rows(chunk_idx));
+                }
+            } catch (...) {
+                errors[decompressor_idx] = std::current_exception();
+                failed = true;
+            }
+            appender.flush();
+        });
+    }
+    for (auto &decompressor : decompressors) {
+        decompressor.join();
+    }
+    unmap_compressed_dataset(view);
+    for (auto &error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+void stream_batches(ExpConfig &config, BoundedQueue<RowStore *> &free_batches, BoundedQueue<RowStore *> &full_batches) {
+    const int64_t capacity = config.stream_batch_rows;
+    BatchAppender appender{free_batches, full_batches, capacity};
+    
+    if (is_compressed_dataset_path(config.dataset_file_path)) {
+        stream_compressed_batches(config, free_batches, full_batches);
+    } else if (is_binary_dataset_path(config.dataset_file_path) && config.io_engine == "uring") {
+        read_binary_dataset_direct(
+            config,
+            capacity,
+            [](const BinaryDatasetHeader &) {},
+            [&](int64_t, int64_t n, const std::vector<const int64_t *> &cols) {
+                appender.append_columns(cols, n);
+            }
+        );
+    } else if (is_binary_dataset_path(config.dataset_file_path)) {
+        ColumnStore view;
+        map_binary_dataset(config.dataset_file_path, view, false);
+        std::vector<const int64_t *> cols(view.n_cols);
+        for (int64_t row_lb = 0; row_lb < view.n_rows; row_lb += capacity) {
+            for (int c = 0; c < view.n_cols; c++) {
+                cols[c] = &view.data[view.get_idx(row_lb, c)];
+            }
+            appender.append_columns(cols, std::min(capacity, view.n_rows - row_lb));
+        }
+        unmap_binary_dataset(view);
+    } else {
+        duckdb::DuckDB db(nullptr);
+        duckdb::Connection con(db);
+        
+        // SendQuery gives a streaming result, so chunks are produced as we pull them
+        auto duckdb_res = con.SendQuery("select key::BIGINT as key, val::BIGINT as val from '" + config.dataset_file_path + "'");
+        if (duckdb_res->HasError()) {
+            throw std::runtime_error(duckdb_res->GetError());
+        }
+        int n_cols = config.data_col_names.size() + 1;
+        std::vector<const int64_t *> cols(n_cols);
+        while (auto chunk = duckdb_res->Fetch()) {
+            if (chunk->size() == 0) {
+                break;
+            }
+            chunk->Flatten();
+            for (int c = 0; c < n_cols; c++) {
+                cols[c] = duckdb::FlatVector::GetData<int64_t>(chunk->data[c]);
+            }
+            appender.append_columns(cols, chunk->size());
+        }
+    }
+    
+    appender.flush();
+    full_batches.close();
+}
+
 std::unordered_map<int64_t, AggMapValue> load_valiadtion_data(ExpConfig &config) {
     duckdb::DuckDB db(nullptr);
     duckdb::Connection con(db);
@@ -60,6 +508,13 @@ void time_print(std::string title, int run_id, chrono_time_point start, chrono_t
     }
 }
 
+void throughput_print(std::string title, int run_id, uint64_t n_bytes, chrono_time_point start, chrono_time_point end, bool do_print_stats) {
+    if (do_print_stats) {
+        double seconds = std::chrono::duration<double>(end - start).count();
+        std::cout << ">>> run=" << run_id << ", " << title << "=" << static_cast<int64_t>(n_bytes / 1e6 / std::max(seconds, 1e-9)) << "MB/s" << std::endl;
+    }
+}
+
 
 
 // cost estimation stuff
@@ -2,14 +2,31 @@
 
 //! Shared library for all other things
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <cstring>
+#include <deque>
 #include <duckdb.hpp>
 #include <iostream>
+#include <mutex>
+#include <new>
 #include <omp.h>
 #include <string>
+#include <thread>
+#include <type_traits>
 #include <flat_hash_map.hpp>
+#include <tsl/robin_map.h>
 #include "xxhash.h"
 
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
 typedef std::chrono::time_point<std::chrono::steady_clock, std::chrono::steady_clock::duration> chrono_time_point;
 typedef std::array<int64_t, 4> AggMapValue; // stores count, sum, min, max
 typedef std::array<int64_t, 4+1> AggResRow; 
@@ -21,27 +38,84 @@ public:
     // std::vector<int64_t> data; 
     int64_t* data; 
     int n_cols;
-    int n_rows;
+    int64_t n_rows;
+    bool is_view = false; // data is not ours to delete
     
-    void init_table(int num_cols, int num_rows) {
+    void init_table(int num_cols, int64_t num_rows) {
         n_cols = num_cols;
         n_rows = num_rows;
         // data.resize(num_cols * num_rows);
-        data = new int64_t[num_cols * num_rows];
+        data = new int64_t[static_cast<size_t>(num_cols) * num_rows];
     }
     
-    inline int get_idx(int row_idx, int col_idx) {
+    inline int64_t get_idx(int64_t row_idx, int col_idx) {
         return col_idx * n_rows + row_idx;
     }
     
-    inline int64_t get(int row_idx, int col_idx) {
+    // point at existing column-major memory (e.g. an mmap-ed binary dataset) instead of allocating
+    void init_view(int num_cols, int64_t num_rows, int64_t *existing_data) {
+        n_cols = num_cols;
+        n_rows = num_rows;
+        data = existing_data;
+        is_view = true;
+    }
+    
+    inline int64_t get(int64_t row_idx, int col_idx) {
         return data[get_idx(row_idx, col_idx)];
     }
     
-    inline void write_value(int row_idx, int col_idx, int64_t value) {
+    inline void write_value(int64_t row_idx, int col_idx, int64_t value) {
         data[get_idx(row_idx, col_idx)] = value;
     }
+    
+    // copy n consecutive values of one column, starting at row_idx
+    inline void write_column_chunk(int64_t row_idx, int col_idx, const int64_t *src, int64_t n) {
+        std::memcpy(&data[get_idx(row_idx, col_idx)], src, n * sizeof(int64_t));
+    }
+
+};
+
+// binary on-disk dataset (see convert.cpp): a header page, then every column as one contiguous
+// int64 segment in column order, i.e. exactly the ColumnStore layout, so it can be mmap-ed in place
+const uint64_t BINARY_DATASET_MAGIC = 0x5942505247524150; // "PARGRPBY"
+const uint32_t BINARY_DATASET_VERSION = 1;
+const size_t BINARY_DATASET_HEADER_SIZE = 4096;
+const int BINARY_DATASET_MAX_COLS = 8;
+enum BinaryColType : uint32_t {
+    BINARY_COL_INT64 = 0,
+};
+
+struct BinaryDatasetHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t n_cols;
+    uint64_t n_rows;
+    uint32_t col_types[BINARY_DATASET_MAX_COLS];
+    uint64_t checksum; // xxh3 chained over the column segments
+};
+static_assert(sizeof(BinaryDatasetHeader) <= BINARY_DATASET_HEADER_SIZE);
+
+// compressed binary dataset (.zbin, see compressed.cpp): a header page, a directory with one entry per
+// (chunk, column), then every column of every chunk of chunk_rows rows deflated on its own,
+// so chunks can be inflated independently, in parallel, or while other threads aggregate
+const uint64_t COMPRESSED_DATASET_MAGIC = 0x5a42505247524150; // "PARGRPBZ"
+const uint32_t COMPRESSED_DATASET_VERSION = 1;
+
+struct CompressedDatasetHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t n_cols;
+    uint64_t n_rows;
+    uint64_t chunk_rows;
+    uint64_t n_chunks;
+    uint32_t col_types[BINARY_DATASET_MAX_COLS];
+};
+static_assert(sizeof(CompressedDatasetHeader) <= BINARY_DATASET_HEADER_SIZE);
 
+struct CompressedChunkEntry {
+    uint64_t offset; // byte offset of the deflated column chunk in the file
+    uint64_t compressed_size;
+    uint64_t checksum; // xxh3 of the uncompressed column chunk
 };
 
 class RowStore {
@@ -49,32 +123,232 @@ public:
     // std::vector<int64_t> data;
     int64_t* data; 
     int n_cols;
-    int n_rows;
+    int64_t n_rows;
     
-    void init_table(int num_cols, int num_rows) {
+    void init_table(int num_cols, int64_t num_rows) {
         n_cols = num_cols;
         n_rows = num_rows;
         // data.resize(num_cols * num_rows);
-        data = new int64_t[num_cols * num_rows];
+        data = new int64_t[static_cast<size_t>(num_cols) * num_rows];
     }
     
-    inline int get_idx(int row_idx, int col_idx) {
+    inline int64_t get_idx(int64_t row_idx, int col_idx) {
         return row_idx * n_cols + col_idx;
     }
     
-    inline void write_value(int row_idx, int col_idx, int64_t value) {
+    inline void write_value(int64_t row_idx, int col_idx, int64_t value) {
         data[get_idx(row_idx, col_idx)] = value;
     }
     
-    inline int64_t get(int row_idx, int col_idx) {
+    // copy n consecutive values of one column, starting at row_idx (strided, since rows are interleaved)
+    inline void write_column_chunk(int64_t row_idx, int col_idx, const int64_t *src, int64_t n) {
+        int64_t *dst = &data[get_idx(row_idx, col_idx)];
+        for (int64_t i = 0; i < n; i++) {
+            dst[i * n_cols] = src[i];
+        }
+    }
+    
+    inline int64_t get(int64_t row_idx, int col_idx) {
         return data[get_idx(row_idx, col_idx)];
     }
 };
 
-// wrapper around hash map with some useful row-level features
-class SimpleHashAggMap {
+// column major storage split into fixed-size segments that are allocated independently,
+// so a multi-billion row table never needs one giant allocation
+// row r lives in segment r >> SEGMENT_ROWS_LOG2, and each segment stores its columns back to back
+class SegmentedStore {
+public:
+    static const int SEGMENT_ROWS_LOG2 = 20;
+    static const int64_t SEGMENT_ROWS = 1LL << SEGMENT_ROWS_LOG2; // 8 MiB per column per segment
+    static const int64_t SEGMENT_MASK = SEGMENT_ROWS - 1;
+    
+    std::vector<int64_t*> segments;
+    int n_cols;
+    int64_t n_rows;
+    
+    void init_table(int num_cols, int64_t num_rows) {
+        n_cols = num_cols;
+        n_rows = num_rows;
+        int64_t n_segments = (num_rows + SEGMENT_ROWS - 1) >> SEGMENT_ROWS_LOG2;
+        segments.resize(n_segments);
+        for (int64_t seg_idx = 0; seg_idx < n_segments; seg_idx++) {
+            segments[seg_idx] = new int64_t[num_cols * SEGMENT_ROWS];
+        }
+    }
+    
+    inline int64_t *get_ptr(int64_t row_idx, int col_idx) {
+        return &segments[row_idx >> SEGMENT_ROWS_LOG2][col_idx * SEGMENT_ROWS + (row_idx & SEGMENT_MASK)];
+    }
+    
+    inline int64_t get(int64_t row_idx, int col_idx) {
+        return *get_ptr(row_idx, col_idx);
+    }
+    
+    inline void write_value(int64_t row_idx, int col_idx, int64_t value) {
+        *get_ptr(row_idx, col_idx) = value;
+    }
+    
+    // copy n consecutive values of one column, starting at row_idx, split at segment boundaries
+    inline void write_column_chunk(int64_t row_idx, int col_idx, const int64_t *src, int64_t n) {
+        while (n > 0) {
+            int64_t n_in_segment = std::min(n, SEGMENT_ROWS - (row_idx & SEGMENT_MASK));
+            std::memcpy(get_ptr(row_idx, col_idx), src, n_in_segment * sizeof(int64_t));
+            row_idx += n_in_segment;
+            src += n_in_segment;
+            n -= n_in_segment;
+        }
+    }
+};
+
+// frame of reference + bit packing, read only: every column stores value - base in the fewest bits that
+// cover its range, so a generated dataset (keys < num_groups, int16 vals) shrinks 4-8x and scans move
+// that much less memory. built from a loaded column store with pack_from (packed.cpp)
+// rows are packed lsb first into 64-bit words, so row r of a column starts at bit r * width
+class PackedStore {
+public:
+    // widths above this are stored as full 64-bit words, so one unaligned 8-byte load always covers a value
+    static const int MAX_PACKED_WIDTH = 57;
+    
+    struct PackedColumn {
+        int64_t base;
+        int width; // bits per value, 0..MAX_PACKED_WIDTH or 64
+        uint64_t mask;
+        uint64_t *words; // 64 rows take exactly width words, plus one word of padding at the end
+    };
+    
+    std::vector<PackedColumn> columns;
+    int n_cols;
+    int64_t n_rows;
+    
+    // encode src in parallel, picking base and width per column from its min and max
+    void pack_from(ColumnStore &src, int num_threads);
+    
+    inline int64_t get(int64_t row_idx, int col_idx) {
+        const PackedColumn &col = columns[col_idx];
+        uint64_t bit = row_idx * col.width;
+        uint64_t word;
+        std::memcpy(&word, reinterpret_cast<const char *>(col.words) + (bit >> 3), sizeof(word));
+        return col.base + static_cast<int64_t>((word >> (bit & 7)) & col.mask);
+    }
+    
+    // decode n consecutive values of one column, starting at row_idx, with simd where available
+    void read_column_chunk(int64_t row_idx, int col_idx, int64_t *dst, int64_t n);
+    
+    size_t packed_bytes() const;
+};
+
+// rows decoded per batch when a layout is unpacked batch by batch during a scan
+const int64_t PACKED_DECODE_BATCH = 1024;
+
+// accumulate rows [row_lb, row_ub) of table into agg_map, packed layouts are unpacked a batch at a time
+// with their simd decoder first, everything else goes row by row
+template <typename AggMap, typename Table>
+inline void accumulate_rows(AggMap &agg_map, Table &table, int64_t row_lb, int64_t row_ub) {
+    if constexpr (std::is_same_v<Table, PackedStore>) {
+        int64_t keys[PACKED_DECODE_BATCH];
+        int64_t vals[PACKED_DECODE_BATCH];
+        for (int64_t batch_lb = row_lb; batch_lb < row_ub; batch_lb += PACKED_DECODE_BATCH) {
+            int64_t n = std::min(PACKED_DECODE_BATCH, row_ub - batch_lb);
+            table.read_column_chunk(batch_lb, 0, keys, n);
+            table.read_column_chunk(batch_lb, 1, vals, n);
+            for (int64_t i = 0; i < n; i++) {
+                agg_map.accumulate_value(keys[i], vals[i]);
+            }
+        }
+    } else {
+        for (int64_t r = row_lb; r < row_ub; r++) {
+            agg_map.accumulate_from_row(table, r);
+        }
+    }
+}
+
+// hash functions for the int64 group keys, picked with --hash. every agg map takes one as its Hasher template
+// argument, and all of them spread keys over the full 64 bits, since partitions come from the high bits of
+// the hash (hash_partition) and map slots from the low ones
+
+// xxh3 over the 8 key bytes, the default
+struct I64Hasher {
+    inline size_t operator()(int64_t key) const {
+        return XXH3_64bits(&key, sizeof(key));
+    }
+};
+
+// one multiply by 2^64 / golden ratio. the product's good bits are the high ones, so fold them onto the low half
+struct MultiplyShiftHasher {
+    inline size_t operator()(int64_t key) const {
+        uint64_t product = static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ULL;
+        return product ^ (product >> 32);
+    }
+};
+
+// crc32c of the key and of its halves swapped, one crc instruction per 32 bits of hash (SSE4.2, ARMv8 crc)
+struct Crc32cHasher {
+    static inline uint32_t crc32c(uint64_t word) {
+#if defined(__SSE4_2__)
+        return static_cast<uint32_t>(_mm_crc32_u64(0, word));
+#elif defined(__ARM_FEATURE_CRC32)
+        return __crc32cd(0, word);
+#else
+        // bitwise, same result as the instruction, only here so --hash crc32c still runs everywhere
+        uint32_t crc = 0;
+        for (int bit = 0; bit < 64; bit++) {
+            crc = (crc >> 1) ^ (0x82F63B78 & -((crc ^ (word >> bit)) & 1));
+        }
+        return crc;
+#endif
+    }
+    
+    inline size_t operator()(int64_t key) const {
+        uint64_t word = static_cast<uint64_t>(key);
+        return (static_cast<uint64_t>(crc32c(word)) << 32) | crc32c((word << 32) | (word >> 32));
+    }
+};
+
+// murmur3's 64 bit finalizer (fmix64), a full avalanche in two multiplies
+struct Murmur3Hasher {
+    inline size_t operator()(int64_t key) const {
+        uint64_t hash = static_cast<uint64_t>(key);
+        hash ^= hash >> 33;
+        hash *= 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 33;
+        hash *= 0xC4CEB9FE1A85EC53ULL;
+        hash ^= hash >> 33;
+        return hash;
+    }
+};
+
+// the partition of a key from the high 32 bits of its hash (multiply-shift, no modulo), while the maps
+// index their slots with the low bits, so rows are hashed once for both and a partition's keys still
+// spread over all of its map's slots
+inline size_t hash_partition(uint64_t hash, size_t n_partitions) {
+    return ((hash >> 32) * n_partitions) >> 32;
+}
+
+// the sub-partition of hash among fanout, inside a partition picked with a combined fan-out of prefix_fanout
+// before. the high 32 hash bits are a fixed point fraction, each level takes the integer part of fraction * fanout
+// and leaves the rest for the next, so levels use hash bits the ones before did not. with prefix_fanout 1 this is
+// hash_partition
+inline size_t sub_partition(uint64_t hash, uint64_t prefix_fanout, size_t fanout) {
+    return ((((hash >> 32) * prefix_fanout) & 0xFFFFFFFFULL) * fanout) >> 32;
+}
+
+// our agg map interface over a third party int64 -> accumulators hash map (std::unordered_map,
+// ska::flat_hash_map or tsl::robin_map), one find per row on hits and an emplace on first sight of a group
+template <typename Map, typename Hasher>
+class WrappedAggMap {
 public:
-    std::unordered_map<int64_t, AggMapValue> agg_map;
+    typedef Hasher hasher;
+    
+    Map agg_map;
+    
+    // the accumulators of group_key, inserted as {0, 0, INT64_MAX, INT64_MIN} if absent
+    inline AggMapValue &upsert(int64_t group_key) {
+        auto search = agg_map.find(group_key);
+        if (search == agg_map.end()) {
+            search = agg_map.emplace(group_key, AggMapValue{0, 0, INT64_MAX, INT64_MIN}).first;
+        }
+        return mutable_value(search);
+    }
     
     inline AggMapValue entry_or_default(int64_t group_key) {
         if (auto search = agg_map.find(group_key); search != agg_map.end()) {
@@ -85,40 +359,53 @@ public:
     }
     
     inline AggMapValue& operator[](int64_t group_key) {
-        return agg_map[group_key];
+        return upsert(group_key);
     }
     
-    inline void accumulate_from_row(RowStore &table, int r) {
-        auto group_key = table.get(r, 0);
-        
-        // find existing entry, if not initialise
-        AggMapValue agg_acc = entry_or_default(group_key);
-
-        // do the aggregation
-        agg_acc[0] = agg_acc[0] + 1; // count
-        agg_acc[1] = agg_acc[1] + table.get(r, 1); // sum
-        agg_acc[2] = std::min(agg_acc[2], table.get(r, 1)); // min
-        agg_acc[3] = std::max(agg_acc[3], table.get(r, 1)); // max
-        
-        agg_map[group_key] = agg_acc;
+    inline void accumulate_value(int64_t group_key, int64_t val) {
+        AggMapValue &agg_acc = upsert(group_key);
+        agg_acc[0] += 1; // count
+        agg_acc[1] += val; // sum
+        agg_acc[2] = std::min(agg_acc[2], val); // min
+        agg_acc[3] = std::max(agg_acc[3], val); // max
+    }
+    
+    // the wrapped map hashes keys itself, so a precomputed hash (e.g. from picking a partition) goes unused
+    inline void accumulate_value(uint64_t /*hash*/, int64_t group_key, int64_t val) {
+        accumulate_value(group_key, val);
+    }
+    
+    template <typename Table>
+    inline void accumulate_from_row(Table &table, int64_t r) {
+        accumulate_value(table.get(r, 0), table.get(r, 1));
+    }
+    
+    template <typename Table>
+    inline void accumulate_from_rows(Table &table, int64_t row_lb, int64_t row_ub) {
+        accumulate_rows(*this, table, row_lb, row_ub);
+    }
+    
+    inline void accumulate_from_agg_acc(int64_t group_key, const AggMapValue &other_agg_acc) {
+        AggMapValue &agg_acc = upsert(group_key);
+        agg_acc[0] += other_agg_acc[0]; // count
+        agg_acc[1] += other_agg_acc[1]; // sum
+        agg_acc[2] = std::min(agg_acc[2], other_agg_acc[2]); // min
+        agg_acc[3] = std::max(agg_acc[3], other_agg_acc[3]); // max
+    }
+    
+    inline void accumulate_from_agg_acc(uint64_t /*hash*/, int64_t group_key, const AggMapValue &other_agg_acc) {
+        accumulate_from_agg_acc(group_key, other_agg_acc);
     }
     
-    inline void merge_from(const SimpleHashAggMap &other_agg_map) {
+    inline void merge_from(const WrappedAggMap &other_agg_map) {
         for (const auto& [group_key, other_agg_acc] : other_agg_map) {
-            AggMapValue agg_acc = entry_or_default(group_key);
-            
-            agg_acc[0] = agg_acc[0] + other_agg_acc[0]; // count
-            agg_acc[1] = agg_acc[1] + other_agg_acc[1]; // sum
-            agg_acc[2] = std::min(agg_acc[2], other_agg_acc[2]); // min
-            agg_acc[3] = std::max(agg_acc[3], other_agg_acc[3]); // max
-            
-            agg_map[group_key] = agg_acc;
+            accumulate_from_agg_acc(group_key, other_agg_acc);
         }
     }
     
     // iterator wrapper implementation referenced https://stackoverflow.com/questions/20681150/should-i-write-iterators-for-a-class-that-is-just-a-wrapper-of-a-vector
-    typedef typename std::unordered_map<int64_t, AggMapValue>::iterator iterator;
-    typedef typename std::unordered_map<int64_t, AggMapValue>::const_iterator const_iterator;
+    typedef typename Map::iterator iterator;
+    typedef typename Map::const_iterator const_iterator;
     iterator begin() { return agg_map.begin(); }
     const_iterator begin() const { return agg_map.begin(); }
     const_iterator cbegin() const { return agg_map.cbegin(); }
@@ -144,89 +431,171 @@ public:
     size_t size() {
         return agg_map.size();
     }
+    
+    void reserve(size_t n) {
+        agg_map.reserve(n);
+    }
+    
+private:
+    // tsl::robin_map only hands out the mapped value mutably through it.value(), the others through it->second
+    template <typename Iterator, typename = void>
+    struct has_value_accessor : std::false_type {};
+    template <typename Iterator>
+    struct has_value_accessor<Iterator, std::void_t<decltype(std::declval<Iterator>().value())>> : std::true_type {};
+    
+    static inline AggMapValue &mutable_value(iterator it) {
+        if constexpr (has_value_accessor<iterator>::value) {
+            return it.value();
+        } else {
+            return it->second;
+        }
+    }
 };
 
-struct I64Hasher {
-    inline size_t operator()(int64_t key) const {
-        return XXH3_64bits(&key, sizeof(key));
+// iterates over the occupied slots of a flat array of (key, accumulators) slots, where empty slots
+// are the ones with a zero count (used by the open addressing maps)
+template <typename SlotT>
+class AggSlotIterator {
+public:
+    AggSlotIterator(SlotT *slot, SlotT *slots_end) : slot(slot), slots_end(slots_end) { skip_empty(); }
+    SlotT &operator*() const { return *slot; }
+    SlotT *operator->() const { return slot; }
+    AggSlotIterator &operator++() { slot++; skip_empty(); return *this; }
+    bool operator==(const AggSlotIterator &other) const { return slot == other.slot; }
+    bool operator!=(const AggSlotIterator &other) const { return slot != other.slot; }
+private:
+    SlotT *slot;
+    SlotT *slots_end;
+    void skip_empty() {
+        while (slot != slots_end && slot->second[0] == 0) {
+            slot++;
+        }
     }
 };
 
-class XXHashAggMap {
+// our own open addressing map: linear probing over a power of two array of slots that hold the
+// accumulators inline, so accumulating a row is one probe and an in-place update
+// (a WrappedAggMap finds the group, then probes again to emplace it if it is new)
+// a slot is empty while its count is 0, every group that exists has been counted at least once
+// grow once size exceeds this fraction of the capacity, set from --map_load_factor
+inline float open_addressing_max_load_factor = 0.5f;
+
+template <typename Hasher>
+class OpenAddressingAggMap {
 public:
-    ska::flat_hash_map<int64_t, AggMapValue, I64Hasher> agg_map;
+    typedef Hasher hasher;
+    typedef std::pair<int64_t, AggMapValue> Slot;
+    
+    static constexpr size_t MIN_CAPACITY = 16;
+    
+    std::vector<Slot> slots;
+    size_t n_entries = 0;
+    size_t capacity_mask = 0;
+    size_t grow_threshold = 0;
+    
+    // the accumulators of group_key, inserted as {0, 0, INT64_MAX, INT64_MIN} if absent
+    // hash is Hasher{}(group_key), passed in when the caller already has it, e.g. from picking a partition
+    inline AggMapValue &upsert(uint64_t hash, int64_t group_key) {
+        if (n_entries >= grow_threshold) {
+            rehash(std::max(MIN_CAPACITY, 2 * slots.size()));
+        }
+        size_t idx = hash & capacity_mask;
+        while (true) {
+            Slot &slot = slots[idx];
+            if (slot.second[0] == 0) {
+                slot.first = group_key;
+                n_entries++;
+                return slot.second;
+            }
+            if (slot.first == group_key) {
+                return slot.second;
+            }
+            idx = (idx + 1) & capacity_mask;
+        }
+    }
     
     inline AggMapValue entry_or_default(int64_t group_key) {
-        if (auto search = agg_map.find(group_key); search != agg_map.end()) {
+        if (auto search = find(group_key); search != end()) {
             return search->second;
         } else {
             return AggMapValue{0, 0, INT64_MAX, INT64_MIN };
         }
     }
     
+    inline AggMapValue &upsert(int64_t group_key) {
+        return upsert(Hasher{}(group_key), group_key);
+    }
+    
     inline AggMapValue& operator[](int64_t group_key) {
-        return agg_map[group_key];
+        return upsert(group_key);
     }
     
-    inline void accumulate_from_row(RowStore &table, int r) {
-        auto group_key = table.get(r, 0);
-        
-        // find existing entry, if not initialise
-        AggMapValue agg_acc = entry_or_default(group_key);
-
-        // do the aggregation
-        agg_acc[0] = agg_acc[0] + 1; // count
-        agg_acc[1] = agg_acc[1] + table.get(r, 1); // sum
-        agg_acc[2] = std::min(agg_acc[2], table.get(r, 1)); // min
-        agg_acc[3] = std::max(agg_acc[3], table.get(r, 1)); // max
-        
-        agg_map[group_key] = agg_acc;
+    inline void accumulate_value(uint64_t hash, int64_t group_key, int64_t val) {
+        AggMapValue &agg_acc = upsert(hash, group_key);
+        agg_acc[0] += 1; // count
+        agg_acc[1] += val; // sum
+        agg_acc[2] = std::min(agg_acc[2], val); // min
+        agg_acc[3] = std::max(agg_acc[3], val); // max
     }
     
-    inline void accumulate_from_agg_acc(int64_t group_key, AggMapValue other_agg_acc) {
-
-        // find existing entry, if not initialise
-        AggMapValue agg_acc = entry_or_default(group_key);
-
-        // do the aggregation
-        agg_acc[0] = agg_acc[0] + other_agg_acc[0]; // count
-        agg_acc[1] = agg_acc[1] + other_agg_acc[1]; // sum
+    inline void accumulate_value(int64_t group_key, int64_t val) {
+        accumulate_value(Hasher{}(group_key), group_key, val);
+    }
+    
+    template <typename Table>
+    inline void accumulate_from_row(Table &table, int64_t r) {
+        accumulate_value(table.get(r, 0), table.get(r, 1));
+    }
+    
+    template <typename Table>
+    inline void accumulate_from_rows(Table &table, int64_t row_lb, int64_t row_ub) {
+        accumulate_rows(*this, table, row_lb, row_ub);
+    }
+    
+    inline void accumulate_from_agg_acc(uint64_t hash, int64_t group_key, const AggMapValue &other_agg_acc) {
+        AggMapValue &agg_acc = upsert(hash, group_key);
+        agg_acc[0] += other_agg_acc[0]; // count
+        agg_acc[1] += other_agg_acc[1]; // sum
         agg_acc[2] = std::min(agg_acc[2], other_agg_acc[2]); // min
         agg_acc[3] = std::max(agg_acc[3], other_agg_acc[3]); // max
-        
-        agg_map[group_key] = agg_acc;
     }
     
-    inline void merge_from(const XXHashAggMap &other_agg_map) {
+    inline void accumulate_from_agg_acc(int64_t group_key, const AggMapValue &other_agg_acc) {
+        accumulate_from_agg_acc(Hasher{}(group_key), group_key, other_agg_acc);
+    }
+    
+    inline void merge_from(const OpenAddressingAggMap &other_agg_map) {
         for (const auto& [group_key, other_agg_acc] : other_agg_map) {
-            AggMapValue agg_acc = entry_or_default(group_key);
-            
-            agg_acc[0] = agg_acc[0] + other_agg_acc[0]; // count
-            agg_acc[1] = agg_acc[1] + other_agg_acc[1]; // sum
-            agg_acc[2] = std::min(agg_acc[2], other_agg_acc[2]); // min
-            agg_acc[3] = std::max(agg_acc[3], other_agg_acc[3]); // max
-            
-            agg_map[group_key] = agg_acc;
+            accumulate_from_agg_acc(group_key, other_agg_acc);
         }
     }
     
-    // iterator wrapper implementation referenced https://stackoverflow.com/questions/20681150/should-i-write-iterators-for-a-class-that-is-just-a-wrapper-of-a-vector
-    typedef typename ska::flat_hash_map<int64_t, AggMapValue, I64Hasher>::iterator iterator;
-    typedef typename ska::flat_hash_map<int64_t, AggMapValue, I64Hasher>::const_iterator const_iterator;
-    iterator begin() { return agg_map.begin(); }
-    const_iterator begin() const { return agg_map.begin(); }
-    const_iterator cbegin() const { return agg_map.cbegin(); }
-    iterator end() { return agg_map.end(); }
-    const_iterator end() const { return agg_map.end(); }
-    const_iterator cend() const { return agg_map.cend(); }
+    typedef AggSlotIterator<Slot> iterator;
+    typedef AggSlotIterator<const Slot> const_iterator;
+    iterator begin() { return iterator(slots.data(), slots.data() + slots.size()); }
+    const_iterator begin() const { return const_iterator(slots.data(), slots.data() + slots.size()); }
+    const_iterator cbegin() const { return begin(); }
+    iterator end() { return iterator(slots.data() + slots.size(), slots.data() + slots.size()); }
+    const_iterator end() const { return const_iterator(slots.data() + slots.size(), slots.data() + slots.size()); }
+    const_iterator cend() const { return end(); }
     
     iterator find(int64_t key) {
-        return agg_map.find(key);
+        if (n_entries == 0) {
+            return end();
+        }
+        size_t idx = Hasher{}(key) & capacity_mask;
+        while (slots[idx].second[0] != 0) {
+            if (slots[idx].first == key) {
+                return iterator(&slots[idx], slots.data() + slots.size());
+            }
+            idx = (idx + 1) & capacity_mask;
+        }
+        return end();
     }
     
     void display() {
         std::cout << "Map Data:" << std::endl;
-        for (const auto& entry : agg_map) {
+        for (const auto& entry : *this) {
             std::cout << "\t" << entry.first << " |-> ";
             for (int i = 0; i < 4; i++) {
                 std::cout << entry.second[i] << " ";
@@ -236,11 +605,35 @@ public:
     }
     
     size_t size() {
-        return agg_map.size();
+        return n_entries;
     }
     
     void reserve(size_t n) {
-        agg_map.reserve(n);
+        size_t capacity = MIN_CAPACITY;
+        while (capacity * open_addressing_max_load_factor < n + 1) {
+            capacity *= 2;
+        }
+        if (capacity > slots.size()) {
+            rehash(capacity);
+        }
+    }
+    
+private:
+    void rehash(size_t new_capacity) {
+        std::vector<Slot> old_slots(new_capacity, Slot{0, AggMapValue{0, 0, INT64_MAX, INT64_MIN}});
+        old_slots.swap(slots);
+        capacity_mask = new_capacity - 1;
+        grow_threshold = std::max<size_t>(1, new_capacity * open_addressing_max_load_factor);
+        for (const Slot &old_slot : old_slots) {
+            if (old_slot.second[0] == 0) {
+                continue;
+            }
+            size_t idx = Hasher{}(old_slot.first) & capacity_mask;
+            while (slots[idx].second[0] != 0) {
+                idx = (idx + 1) & capacity_mask;
+            }
+            slots[idx] = old_slot;
+        }
     }
 };
 
@@ -252,11 +645,25 @@ public:
     int batch_size;
     int duckdb_style_adaptation_threshold;
     std::string algorithm;
+    std::string layout;
     int num_dryruns;
     int num_trials;
     int cardinality_reduction;
     std::string dataset_file_path;
     std::string validation_file_path;
+    bool verify_checksum;
+    std::string loader;
+    bool streaming;
+    int stream_batch_rows;
+    int stream_max_batches;
+    int stream_decompress_threads;
+    std::string io_engine;
+    int io_queue_depth;
+    std::string map_backend;
+    float map_load_factor;
+    std::string hash;
+    std::string lock_free_layout;
+    bool heavy_hitters;
     std::string in_table_name;
     std::string group_key_col_name;
     std::vector<std::string> data_col_names;
@@ -268,8 +675,22 @@ public:
         std::cout << "batch_size = " << batch_size << std::endl;
         std::cout << "duckdb_style_adaptation_threshold = " << duckdb_style_adaptation_threshold << std::endl;
         std::cout << "algorithm = " << algorithm << std::endl;
+        std::cout << "layout = " << layout << std::endl;
         std::cout << "dataset_file_path = " << dataset_file_path << std::endl;
         std::cout << "validation_file_path = " << validation_file_path << std::endl;
+        std::cout << "verify_checksum = " << verify_checksum << std::endl;
+        std::cout << "loader = " << loader << std::endl;
+        std::cout << "streaming = " << streaming << std::endl;
+        std::cout << "stream_batch_rows = " << stream_batch_rows << std::endl;
+        std::cout << "stream_max_batches = " << stream_max_batches << std::endl;
+        std::cout << "stream_decompress_threads = " << stream_decompress_threads << std::endl;
+        std::cout << "io_engine = " << io_engine << std::endl;
+        std::cout << "io_queue_depth = " << io_queue_depth << std::endl;
+        std::cout << "map_backend = " << map_backend << std::endl;
+        std::cout << "map_load_factor = " << map_load_factor << std::endl;
+        std::cout << "hash = " << hash << std::endl;
+        std::cout << "lock_free_layout = " << lock_free_layout << std::endl;
+        std::cout << "heavy_hitters = " << heavy_hitters << std::endl;
         std::cout << "in_table_name = " << in_table_name << std::endl;
         std::cout << "group_key_col_name = " << group_key_col_name << std::endl;
         std::cout << "data_col_names = [";
@@ -280,115 +701,1849 @@ public:
     }
 };
 
-// using config specification, load stuff into table
-// for now, assume one group column, and group key column is not any of the value columns
-void load_data(ExpConfig &config, RowStore &table);
-
-
-
-void time_print(std::string title, int run_id, chrono_time_point start, chrono_time_point end, bool do_print_stats);
-std::unordered_map<int64_t, AggMapValue> load_valiadtion_data(ExpConfig &config);
-
-struct AggEntry
-{
-    std::atomic<int64_t> key;
-    std::atomic<int64_t> cnt;
-    std::atomic<int64_t> sum;
-    std::atomic<int64_t> min;
-    std::atomic<int64_t> max;
-    AggEntry() : key(INT64_MIN), cnt(0), sum(0), min(INT64_MAX), max(INT64_MIN) {}
-};
-
-struct AggEntrySnapshot
-{
-    int64_t key;
-    int64_t cnt;
-    int64_t sum;
-    int64_t min;
-    int64_t max;
-};
-
-class LockFreeAggMap
-{
-    public:
-        explicit LockFreeAggMap(size_t n)
-            : size(n), data(n) {}
-
-        inline bool upsert(int64_t k, int64_t v)
-        {
-            size_t i = std::hash<int64_t>{} (k);
-            for (size_t probe = 0; probe < size; probe++)
-            {
-                size_t j = (i + probe) % size;
-                int64_t expected = INT64_MIN;
-
-                if (data[j].key.compare_exchange_strong(expected, k, std::memory_order_acq_rel, std::memory_order_acquire) || expected == k)
-                {
-                    data[j].cnt.fetch_add(1, std::memory_order_relaxed);
-                    data[j].sum.fetch_add(v, std::memory_order_relaxed);
-                    int64_t cur_min = data[j].min.load(std::memory_order_relaxed);
-                    while (v < cur_min && !data[j].min.compare_exchange_weak(cur_min, v, std::memory_order_relaxed));
-                    int64_t cur_max = data[j].max.load(std::memory_order_relaxed);
-                    while (v > cur_max && !data[j].max.compare_exchange_weak(cur_max, v, std::memory_order_relaxed));
-                    return true;
+// swiss table style map: a control byte per slot holding 7 bits of the hash (or EMPTY), probed a group of
+// 16 slots at a time with one sse2 compare, and the (key, accumulators) payload in a separate array, so a
+// miss touches mostly the dense control bytes instead of 40 byte slots
+// groups are probed quadratically, slots within a group by tag match; nothing is ever deleted, so no tombstones
+// counts lookups and probed groups of the keys with tag 0 (1 in 128) so runs can report probes per lookup
+// without paying for the counters on every row
+template <typename Hasher>
+class SwissAggMap {
+public:
+    typedef Hasher hasher;
+    typedef std::pair<int64_t, AggMapValue> Slot;
+    
+    static constexpr int GROUP_SIZE = 16;
+    static constexpr uint8_t EMPTY = 0x80;
+    static constexpr size_t MIN_CAPACITY = 16;
+    // swiss tables stay fast up to 7/8 full, since a probe checks 16 slots at once
+    static constexpr size_t MAX_LOAD_NUM = 7;
+    static constexpr size_t MAX_LOAD_DEN = 8;
+    
+    std::vector<uint8_t> ctrl;
+    std::vector<Slot> slots;
+    size_t n_entries = 0;
+    size_t group_mask = 0;
+    size_t grow_threshold = 0;
+    uint64_t n_lookups = 0; // sampled, see sample_probes
+    uint64_t n_probed_groups = 0;
+    
+    // the tag is uniform and independent of the probe sequence, so tag 0 is an unbiased sample
+    inline void sample_probes(uint8_t tag, size_t n_probes) {
+        if (tag == 0) {
+            n_lookups++;
+            n_probed_groups += n_probes;
+        }
+    }
+    
+    // bit i set where ctrl[group_start + i] == byte
+    static inline uint32_t match_byte(const uint8_t *group_ctrl, uint8_t byte) {
+#if defined(__SSE2__)
+        __m128i ctrl_bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group_ctrl));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl_bytes, _mm_set1_epi8(static_cast<char>(byte)))));
+#else
+        uint32_t mask = 0;
+        for (int i = 0; i < GROUP_SIZE; i++) {
+            mask |= static_cast<uint32_t>(group_ctrl[i] == byte) << i;
+        }
+        return mask;
+#endif
+    }
+    
+    // the accumulators of group_key, inserted as {0, 0, INT64_MAX, INT64_MIN} if absent
+    // hash is Hasher{}(group_key), passed in when the caller already has it, e.g. from picking a partition
+    inline AggMapValue &upsert(uint64_t hash, int64_t group_key) {
+        if (n_entries >= grow_threshold) {
+            rehash(std::max(MIN_CAPACITY, 2 * slots.size()));
+        }
+        uint8_t tag = hash & 0x7F;
+        size_t group_idx = (hash >> 7) & group_mask;
+        for (size_t probe = 1; ; probe++) {
+            const uint8_t *group_ctrl = &ctrl[group_idx * GROUP_SIZE];
+            for (uint32_t matches = match_byte(group_ctrl, tag); matches != 0; matches &= matches - 1) {
+                Slot &slot = slots[group_idx * GROUP_SIZE + __builtin_ctz(matches)];
+                if (slot.first == group_key) {
+                    sample_probes(tag, probe);
+                    return slot.second;
                 }
             }
-            return false;
+            if (uint32_t empties = match_byte(group_ctrl, EMPTY); empties != 0) {
+                size_t slot_idx = group_idx * GROUP_SIZE + __builtin_ctz(empties);
+                ctrl[slot_idx] = tag;
+                slots[slot_idx].first = group_key;
+                n_entries++;
+                sample_probes(tag, probe);
+                return slots[slot_idx].second;
+            }
+            group_idx = (group_idx + probe) & group_mask;
+        }
+    }
+    
+    inline AggMapValue entry_or_default(int64_t group_key) {
+        if (auto search = find(group_key); search != end()) {
+            return search->second;
+        } else {
+            return AggMapValue{0, 0, INT64_MAX, INT64_MIN };
+        }
+    }
+    
+    inline AggMapValue &upsert(int64_t group_key) {
+        return upsert(Hasher{}(group_key), group_key);
+    }
+    
+    inline AggMapValue& operator[](int64_t group_key) {
+        return upsert(group_key);
+    }
+    
+    inline void accumulate_value(uint64_t hash, int64_t group_key, int64_t val) {
+        AggMapValue &agg_acc = upsert(hash, group_key);
+        agg_acc[0] += 1; // count
+        agg_acc[1] += val; // sum
+        agg_acc[2] = std::min(agg_acc[2], val); // min
+        agg_acc[3] = std::max(agg_acc[3], val); // max
+    }
+    
+    inline void accumulate_value(int64_t group_key, int64_t val) {
+        accumulate_value(Hasher{}(group_key), group_key, val);
+    }
+    
+    template <typename Table>
+    inline void accumulate_from_row(Table &table, int64_t r) {
+        accumulate_value(table.get(r, 0), table.get(r, 1));
+    }
+    
+    template <typename Table>
+    inline void accumulate_from_rows(Table &table, int64_t row_lb, int64_t row_ub) {
+        accumulate_rows(*this, table, row_lb, row_ub);
+    }
+    
+    inline void accumulate_from_agg_acc(uint64_t hash, int64_t group_key, const AggMapValue &other_agg_acc) {
+        AggMapValue &agg_acc = upsert(hash, group_key);
+        agg_acc[0] += other_agg_acc[0]; // count
+        agg_acc[1] += other_agg_acc[1]; // sum
+        agg_acc[2] = std::min(agg_acc[2], other_agg_acc[2]); // min
+        agg_acc[3] = std::max(agg_acc[3], other_agg_acc[3]); // max
+    }
+    
+    inline void accumulate_from_agg_acc(int64_t group_key, const AggMapValue &other_agg_acc) {
+        accumulate_from_agg_acc(Hasher{}(group_key), group_key, other_agg_acc);
+    }
+    
+    inline void merge_from(const SwissAggMap &other_agg_map) {
+        for (const auto& [group_key, other_agg_acc] : other_agg_map) {
+            accumulate_from_agg_acc(group_key, other_agg_acc);
+        }
+    }
+    
+    typedef AggSlotIterator<Slot> iterator;
+    typedef AggSlotIterator<const Slot> const_iterator;
+    iterator begin() { return iterator(slots.data(), slots.data() + slots.size()); }
+    const_iterator begin() const { return const_iterator(slots.data(), slots.data() + slots.size()); }
+    const_iterator cbegin() const { return begin(); }
+    iterator end() { return iterator(slots.data() + slots.size(), slots.data() + slots.size()); }
+    const_iterator end() const { return const_iterator(slots.data() + slots.size(), slots.data() + slots.size()); }
+    const_iterator cend() const { return end(); }
+    
+    iterator find(int64_t key) {
+        if (n_entries == 0) {
+            return end();
         }
-        
-        inline bool accumulate_from_accval(int64_t k, AggMapValue val) {
-            size_t i = std::hash<int64_t>{} (k);
-            for (size_t probe = 0; probe < size; probe++)
-            {
-                size_t j = (i + probe) % size;
-                int64_t expected = INT64_MIN;
-
-                if (data[j].key.compare_exchange_strong(expected, k, std::memory_order_acq_rel, std::memory_order_acquire) || expected == k)
-                {
-                    data[j].cnt.fetch_add(val[0], std::memory_order_relaxed);
-                    data[j].sum.fetch_add(val[1], std::memory_order_relaxed);
-                    int64_t cur_min = data[j].min.load(std::memory_order_relaxed);
-                    while (val[2] < cur_min && !data[j].min.compare_exchange_weak(cur_min, val[2], std::memory_order_relaxed));
-                    int64_t cur_max = data[j].max.load(std::memory_order_relaxed);
-                    while (val[3] > cur_max && !data[j].max.compare_exchange_weak(cur_max, val[3], std::memory_order_relaxed));
-                    return true;
+        size_t hash = Hasher{}(key);
+        uint8_t tag = hash & 0x7F;
+        size_t group_idx = (hash >> 7) & group_mask;
+        for (size_t probe = 1; ; probe++) {
+            const uint8_t *group_ctrl = &ctrl[group_idx * GROUP_SIZE];
+            for (uint32_t matches = match_byte(group_ctrl, tag); matches != 0; matches &= matches - 1) {
+                size_t slot_idx = group_idx * GROUP_SIZE + __builtin_ctz(matches);
+                if (slots[slot_idx].first == key) {
+                    return iterator(&slots[slot_idx], slots.data() + slots.size());
                 }
             }
-            return false;
+            if (match_byte(group_ctrl, EMPTY) != 0) {
+                return end();
+            }
+            group_idx = (group_idx + probe) & group_mask;
         }
-
-        inline bool accumulate_from_accval_elems(int64_t k, int64_t cnt, int64_t sum, int64_t min, int64_t max) {
-            size_t i = std::hash<int64_t>{} (k);
-            for (size_t probe = 0; probe < size; probe++)
-            {
-                size_t j = (i + probe) % size;
-                int64_t expected = INT64_MIN;
-
-                if (data[j].key.compare_exchange_strong(expected, k, std::memory_order_acq_rel, std::memory_order_acquire) || expected == k)
-                {
-                    data[j].cnt.fetch_add(cnt, std::memory_order_relaxed);
-                    data[j].sum.fetch_add(sum, std::memory_order_relaxed);
-                    int64_t cur_min = data[j].min.load(std::memory_order_relaxed);
-                    while (min < cur_min && !data[j].min.compare_exchange_weak(cur_min, min, std::memory_order_relaxed));
-                    int64_t cur_max = data[j].max.load(std::memory_order_relaxed);
-                    while (max > cur_max && !data[j].max.compare_exchange_weak(cur_max, max, std::memory_order_relaxed));
-                    return true;
+    }
+    
+    void display() {
+        std::cout << "Map Data:" << std::endl;
+        for (const auto& entry : *this) {
+            std::cout << "\t" << entry.first << " |-> ";
+            for (int i = 0; i < 4; i++) {
+                std::cout << entry.second[i] << " ";
+            }
+            std::cout << std::endl;
+        }
+    }
+    
+    size_t size() {
+        return n_entries;
+    }
+    
+    void reserve(size_t n) {
+        size_t capacity = MIN_CAPACITY;
+        while (capacity * MAX_LOAD_NUM / MAX_LOAD_DEN < n + 1) {
+            capacity *= 2;
+        }
+        if (capacity > slots.size()) {
+            rehash(capacity);
+        }
+    }
+    
+private:
+    void rehash(size_t new_capacity) {
+        std::vector<Slot> old_slots(new_capacity, Slot{0, AggMapValue{0, 0, INT64_MAX, INT64_MIN}});
+        old_slots.swap(slots);
+        ctrl.assign(new_capacity, EMPTY);
+        group_mask = new_capacity / GROUP_SIZE - 1;
+        grow_threshold = new_capacity * MAX_LOAD_NUM / MAX_LOAD_DEN;
+        for (const Slot &old_slot : old_slots) {
+            if (old_slot.second[0] == 0) {
+                continue;
+            }
+            size_t hash = Hasher{}(old_slot.first);
+            size_t group_idx = (hash >> 7) & group_mask;
+            for (size_t probe = 1; ; probe++) {
+                if (uint32_t empties = match_byte(&ctrl[group_idx * GROUP_SIZE], EMPTY); empties != 0) {
+                    size_t slot_idx = group_idx * GROUP_SIZE + __builtin_ctz(empties);
+                    ctrl[slot_idx] = hash & 0x7F;
+                    slots[slot_idx] = old_slot;
+                    break;
                 }
+                group_idx = (group_idx + probe) & group_mask;
             }
-            return false;
         }
+    }
+};
+
+// append-only storage of (key, accumulators) entries together with the hash of each key, in fixed size
+// blocks so growing never copies entries that are already there. entries are addressed by their index
+const int AGG_PAYLOAD_BLOCK_SHIFT = 12;
+const size_t AGG_PAYLOAD_BLOCK_ENTRIES = 1 << AGG_PAYLOAD_BLOCK_SHIFT;
+
+struct AggPayloadBlock {
+    std::vector<uint64_t> hashes;
+    std::vector<std::pair<int64_t, AggMapValue>> entries;
+};
+
+// iterates over the entries of consecutive payload blocks, every block but the last one is full
+template <typename BlockT>
+class AggPayloadIterator {
+public:
+    typedef std::conditional_t<std::is_const_v<BlockT>, const std::pair<int64_t, AggMapValue>, std::pair<int64_t, AggMapValue>> EntryT;
+    AggPayloadIterator(BlockT *block, size_t offset) : block(block), offset(offset) {}
+    EntryT &operator*() const { return block->entries[offset]; }
+    EntryT *operator->() const { return &block->entries[offset]; }
+    AggPayloadIterator &operator++() {
+        if (++offset == block->entries.size()) {
+            block++;
+            offset = 0;
+        }
+        return *this;
+    }
+    bool operator==(const AggPayloadIterator &other) const { return block == other.block && offset == other.offset; }
+    bool operator!=(const AggPayloadIterator &other) const { return !(*this == other); }
+private:
+    BlockT *block;
+    size_t offset;
+};
+
+class AggPayload {
+public:
+    typedef std::pair<int64_t, AggMapValue> Entry;
+    
+    std::vector<AggPayloadBlock> blocks;
+    size_t n_entries = 0;
+    
+    // returns the index of the new entry
+    inline size_t append(uint64_t hash, int64_t group_key, const AggMapValue &agg_acc = AggMapValue{0, 0, INT64_MAX, INT64_MIN}) {
+        if ((n_entries & (AGG_PAYLOAD_BLOCK_ENTRIES - 1)) == 0) {
+            blocks.emplace_back();
+            blocks.back().hashes.reserve(AGG_PAYLOAD_BLOCK_ENTRIES);
+            blocks.back().entries.reserve(AGG_PAYLOAD_BLOCK_ENTRIES);
+        }
+        blocks.back().hashes.push_back(hash);
+        blocks.back().entries.emplace_back(group_key, agg_acc);
+        return n_entries++;
+    }
+    
+    inline Entry &entry(size_t entry_idx) {
+        return blocks[entry_idx >> AGG_PAYLOAD_BLOCK_SHIFT].entries[entry_idx & (AGG_PAYLOAD_BLOCK_ENTRIES - 1)];
+    }
+    
+    inline uint64_t hash(size_t entry_idx) const {
+        return blocks[entry_idx >> AGG_PAYLOAD_BLOCK_SHIFT].hashes[entry_idx & (AGG_PAYLOAD_BLOCK_ENTRIES - 1)];
+    }
+    
+    size_t size() const {
+        return n_entries;
+    }
+};
+
+// duckdb style two level table: the hash table proper is a compact array of pointers, each the index of an
+// entry in the payload plus 16 salt bits of its hash, and the groups live in append-only payload blocks that
+// keep the hash next to them. probing compares salts before touching the payload, growing rebuilds only
+// the pointer array from the stored hashes, and partitioning is a linear scan over the payload routing each
+// entry by its stored hash, so nothing is ever hashed twice once it is in a table
+template <typename Hasher>
+class PayloadAggMap {
+public:
+    typedef Hasher hasher;
+    
+    static constexpr size_t MIN_CAPACITY = 16;
+    static constexpr int SALT_SHIFT = 48;
+    static constexpr uint64_t INDEX_MASK = (1ULL << SALT_SHIFT) - 1;
+    
+    AggPayload payload;
+    std::vector<uint64_t> pointers; // salt << SALT_SHIFT | (entry index + 1), 0 is an empty slot
+    size_t capacity_mask = 0;
+    
+    // slots come from the low bits of the hash and partitions from the high ones (hash_partition), so the salt
+    // takes bits 32..47, which still vary between the entries of one partition
+    static inline uint64_t salt_of(uint64_t hash) {
+        return (hash << 16) & ~INDEX_MASK;
+    }
+    
+    // the accumulators of group_key, appended as {0, 0, INT64_MAX, INT64_MIN} if absent
+    inline AggMapValue &upsert(uint64_t hash, int64_t group_key) {
+        if (2 * (payload.size() + 1) > pointers.size()) {
+            rebuild_pointers(std::max(MIN_CAPACITY, 2 * pointers.size()));
+        }
+        uint64_t salt = salt_of(hash);
+        size_t idx = hash & capacity_mask;
+        while (true) {
+            uint64_t pointer = pointers[idx];
+            if (pointer == 0) {
+                size_t entry_idx = payload.append(hash, group_key);
+                pointers[idx] = salt | (entry_idx + 1);
+                return payload.entry(entry_idx).second;
+            }
+            if ((pointer & ~INDEX_MASK) == salt) {
+                AggPayload::Entry &entry = payload.entry((pointer & INDEX_MASK) - 1);
+                if (entry.first == group_key) {
+                    return entry.second;
+                }
+            }
+            idx = (idx + 1) & capacity_mask;
+        }
+    }
+    
+    inline AggMapValue entry_or_default(int64_t group_key) {
+        if (auto search = find(group_key); search != end()) {
+            return search->second;
+        } else {
+            return AggMapValue{0, 0, INT64_MAX, INT64_MIN };
+        }
+    }
+    
+    inline AggMapValue& operator[](int64_t group_key) {
+        return upsert(Hasher{}(group_key), group_key);
+    }
+    
+    inline void accumulate_value(uint64_t hash, int64_t group_key, int64_t val) {
+        AggMapValue &agg_acc = upsert(hash, group_key);
+        agg_acc[0] += 1; // count
+        agg_acc[1] += val; // sum
+        agg_acc[2] = std::min(agg_acc[2], val); // min
+        agg_acc[3] = std::max(agg_acc[3], val); // max
+    }
+    
+    inline void accumulate_value(int64_t group_key, int64_t val) {
+        accumulate_value(Hasher{}(group_key), group_key, val);
+    }
+    
+    template <typename Table>
+    inline void accumulate_from_row(Table &table, int64_t r) {
+        accumulate_value(table.get(r, 0), table.get(r, 1));
+    }
+    
+    template <typename Table>
+    inline void accumulate_from_rows(Table &table, int64_t row_lb, int64_t row_ub) {
+        accumulate_rows(*this, table, row_lb, row_ub);
+    }
+    
+    inline void accumulate_from_agg_acc(uint64_t hash, int64_t group_key, const AggMapValue &other_agg_acc) {
+        AggMapValue &agg_acc = upsert(hash, group_key);
+        agg_acc[0] += other_agg_acc[0]; // count
+        agg_acc[1] += other_agg_acc[1]; // sum
+        agg_acc[2] = std::min(agg_acc[2], other_agg_acc[2]); // min
+        agg_acc[3] = std::max(agg_acc[3], other_agg_acc[3]); // max
+    }
+    
+    inline void accumulate_from_agg_acc(int64_t group_key, const AggMapValue &other_agg_acc) {
+        accumulate_from_agg_acc(Hasher{}(group_key), group_key, other_agg_acc);
+    }
+    
+    // merge entries using their stored hashes, e.g. one thread's share of a partition
+    inline void merge_from(const AggPayload &other_payload) {
+        for (const auto &block : other_payload.blocks) {
+            for (size_t i = 0; i < block.entries.size(); i++) {
+                accumulate_from_agg_acc(block.hashes[i], block.entries[i].first, block.entries[i].second);
+            }
+        }
+    }
+    
+    inline void merge_from(const PayloadAggMap &other_agg_map) {
+        merge_from(other_agg_map.payload);
+    }
+    
+    // append every entry to partitions[hash_partition(hash)][tid], partitions[p][t] being thread t's share of partition p
+    void scatter_to_partitions(std::vector<std::vector<AggPayload>> &partitions, int tid) const {
+        size_t n_partitions = partitions.size();
+        for (const auto &block : payload.blocks) {
+            for (size_t i = 0; i < block.entries.size(); i++) {
+                partitions[hash_partition(block.hashes[i], n_partitions)][tid].append(block.hashes[i], block.entries[i].first, block.entries[i].second);
+            }
+        }
+    }
+    
+    typedef AggPayloadIterator<AggPayloadBlock> iterator;
+    typedef AggPayloadIterator<const AggPayloadBlock> const_iterator;
+    iterator begin() { return iterator(payload.blocks.data(), 0); }
+    const_iterator begin() const { return const_iterator(payload.blocks.data(), 0); }
+    const_iterator cbegin() const { return begin(); }
+    iterator end() { return iterator(payload.blocks.data() + payload.blocks.size(), 0); }
+    const_iterator end() const { return const_iterator(payload.blocks.data() + payload.blocks.size(), 0); }
+    const_iterator cend() const { return end(); }
+    
+    iterator find(int64_t key) {
+        if (payload.size() == 0) {
+            return end();
+        }
+        uint64_t hash = Hasher{}(key);
+        uint64_t salt = salt_of(hash);
+        for (size_t idx = hash & capacity_mask; pointers[idx] != 0; idx = (idx + 1) & capacity_mask) {
+            if ((pointers[idx] & ~INDEX_MASK) == salt) {
+                size_t entry_idx = (pointers[idx] & INDEX_MASK) - 1;
+                if (payload.entry(entry_idx).first == key) {
+                    return iterator(&payload.blocks[entry_idx >> AGG_PAYLOAD_BLOCK_SHIFT], entry_idx & (AGG_PAYLOAD_BLOCK_ENTRIES - 1));
+                }
+            }
+        }
+        return end();
+    }
+    
+    void display() {
+        std::cout << "Map Data:" << std::endl;
+        for (const auto& entry : *this) {
+            std::cout << "\t" << entry.first << " |-> ";
+            for (int i = 0; i < 4; i++) {
+                std::cout << entry.second[i] << " ";
+            }
+            std::cout << std::endl;
+        }
+    }
+    
+    size_t size() {
+        return payload.size();
+    }
+    
+    void reserve(size_t n) {
+        size_t capacity = MIN_CAPACITY;
+        while (capacity < 2 * (n + 1)) {
+            capacity *= 2;
+        }
+        if (capacity > pointers.size()) {
+            rebuild_pointers(capacity);
+        }
+    }
+    
+private:
+    // entries are unique, so placing them needs neither a key compare nor a hash computation
+    void rebuild_pointers(size_t new_capacity) {
+        pointers.assign(new_capacity, 0);
+        capacity_mask = new_capacity - 1;
+        for (size_t entry_idx = 0; entry_idx < payload.size(); entry_idx++) {
+            uint64_t hash = payload.hash(entry_idx);
+            size_t idx = hash & capacity_mask;
+            while (pointers[idx] != 0) {
+                idx = (idx + 1) & capacity_mask;
+            }
+            pointers[idx] = salt_of(hash) | (entry_idx + 1);
+        }
+    }
+};
+
+// --map_backend: every backend gives an agg map type per hash function, AggMap<Backend, Hasher>, and all of
+// them share the interface above, so algorithms take the map as a single template argument
+struct StdMapBackend {
+    template <typename Hasher>
+    using agg_map = WrappedAggMap<std::unordered_map<int64_t, AggMapValue, Hasher>, Hasher>;
+};
+
+struct SkaMapBackend {
+    template <typename Hasher>
+    using agg_map = WrappedAggMap<ska::flat_hash_map<int64_t, AggMapValue, Hasher>, Hasher>;
+};
+
+struct RobinMapBackend {
+    template <typename Hasher>
+    using agg_map = WrappedAggMap<tsl::robin_map<int64_t, AggMapValue, Hasher>, Hasher>;
+};
+
+struct OpenAddressingMapBackend {
+    template <typename Hasher>
+    using agg_map = OpenAddressingAggMap<Hasher>;
+};
+
+struct SwissMapBackend {
+    template <typename Hasher>
+    using agg_map = SwissAggMap<Hasher>;
+};
+
+template <typename Backend, typename Hasher>
+using AggMap = typename Backend::template agg_map<Hasher>;
+
+// calls fn(hash, group_key, agg_acc) on every entry, payloads keep their hashes and maps hash again
+template <typename Fn>
+inline void for_each_hashed(AggPayload &payload, Fn &&fn) {
+    for (const auto &block : payload.blocks) {
+        for (size_t i = 0; i < block.entries.size(); i++) {
+            fn(block.hashes[i], block.entries[i].first, block.entries[i].second);
+        }
+    }
+}
+
+template <typename Map, typename Fn>
+inline void for_each_hashed(Map &agg_map, Fn &&fn) {
+    for (auto& [group_key, agg_acc] : agg_map) {
+        fn(typename Map::hasher{}(group_key), group_key, agg_acc);
+    }
+}
+
+// the last phase of the radix algorithms merges every partition's per-thread shares, one partition per task. a
+// partition holding more than twice the average entries is split into pieces of about the average by
+// sub_partition, so a few large partitions do not make up the phase's tail: its shares are scattered into one
+// payload per (piece, thread) first, a task per (partition, thread), then every piece is merged into a Map of its
+// own. merge tasks come largest first, partitions left whole are merged by the caller as before
+template <typename Map>
+class RadixMergePlan {
+public:
+    static constexpr int MAX_PIECES_PER_THREAD = 4;
+
+    struct Task {
+        size_t part_idx;
+        size_t idx; // the piece in merge tasks, the thread in scatter tasks
+    };
+
+    // from one thread, partition_sizes[p] being the entries over all of partition p's shares
+    void plan(const std::vector<size_t> &partition_sizes, int n_threads) {
+        n_partitions = partition_sizes.size();
+        size_t n_entries = 0;
+        for (size_t part_size : partition_sizes) {
+            n_entries += part_size;
+        }
+        size_t avg_size = std::max<size_t>(1, n_entries / n_partitions);
+
+        n_pieces.assign(n_partitions, 1);
+        piece_payloads.assign(n_partitions, {});
+        piece_maps.assign(n_partitions, {});
+        scatter_tasks.clear();
+        merge_tasks.clear();
+        n_split = 0;
+        std::vector<std::pair<size_t, Task>> sized_tasks;
+        for (size_t part_idx = 0; part_idx < n_partitions; part_idx++) {
+            size_t part_size = partition_sizes[part_idx];
+            if (part_size <= 2 * avg_size) {
+                sized_tasks.push_back({part_size, Task{part_idx, 0}});
+                continue;
+            }
+            size_t part_pieces = std::min<size_t>((part_size + avg_size - 1) / avg_size, MAX_PIECES_PER_THREAD * n_threads);
+            n_pieces[part_idx] = part_pieces;
+            piece_payloads[part_idx].assign(part_pieces, std::vector<AggPayload>(n_threads));
+            piece_maps[part_idx].resize(part_pieces);
+            for (int tid = 0; tid < n_threads; tid++) {
+                scatter_tasks.push_back(Task{part_idx, static_cast<size_t>(tid)});
+            }
+            for (size_t piece_idx = 0; piece_idx < part_pieces; piece_idx++) {
+                sized_tasks.push_back({part_size / part_pieces, Task{part_idx, piece_idx}});
+            }
+            n_split++;
+        }
+        std::stable_sort(sized_tasks.begin(), sized_tasks.end(), [](const auto &a, const auto &b) { return a.first > b.first; });
+        for (auto &sized_task : sized_tasks) {
+            merge_tasks.push_back(sized_task.second);
+        }
+    }
+
+    size_t n_scatter_tasks() const { return scatter_tasks.size(); }
+    const Task &scatter_task(size_t task_idx) const { return scatter_tasks[task_idx]; }
+    size_t n_merge_tasks() const { return merge_tasks.size(); }
+    const Task &merge_task(size_t task_idx) const { return merge_tasks[task_idx]; }
+    bool is_split(size_t part_idx) const { return n_pieces[part_idx] > 1; }
+
+    // share is thread tid's share of the split partition part_idx, an AggPayload or an agg map
+    template <typename Share>
+    void scatter(size_t part_idx, int tid, Share &share) {
+        size_t part_pieces = n_pieces[part_idx];
+        for_each_hashed(share, [&](uint64_t hash, int64_t group_key, const AggMapValue &agg_acc) {
+            piece_payloads[part_idx][sub_partition(hash, n_partitions, part_pieces)][tid].append(hash, group_key, agg_acc);
+        });
+    }
+
+    void merge_piece(size_t part_idx, size_t piece_idx) {
+        Map &agg_map = piece_maps[part_idx][piece_idx];
+        size_t n_entries = 0;
+        for (auto &payload : piece_payloads[part_idx][piece_idx]) {
+            n_entries += payload.size();
+        }
+        agg_map.reserve(n_entries);
+        for (auto &payload : piece_payloads[part_idx][piece_idx]) {
+            for_each_hashed(payload, [&](uint64_t hash, int64_t group_key, const AggMapValue &agg_acc) {
+                agg_map.accumulate_from_agg_acc(hash, group_key, agg_acc);
+            });
+        }
+    }
+
+    // the merged pieces of a split partition, their groups are disjoint
+    std::vector<Map> &pieces(size_t part_idx) { return piece_maps[part_idx]; }
+
+    void stats_print(int trial_idx, bool do_print_stats) const {
+        if (do_print_stats) {
+            std::cout << ">>> run=" << trial_idx << ", merge_split_partitions=" << n_split << std::endl;
+            std::cout << ">>> run=" << trial_idx << ", merge_tasks=" << merge_tasks.size() << std::endl;
+        }
+    }
+
+private:
+    size_t n_partitions = 0;
+    size_t n_split = 0;
+    std::vector<size_t> n_pieces;
+    std::vector<std::vector<std::vector<AggPayload>>> piece_payloads; // [partition][piece][thread]
+    std::vector<std::vector<Map>> piece_maps; // [partition][piece]
+    std::vector<Task> scatter_tasks;
+    std::vector<Task> merge_tasks;
+};
+
+// maps that count their probes (SwissAggMap)
+template <typename AggMap>
+struct counts_probes : std::false_type {};
+template <typename Hasher>
+struct counts_probes<SwissAggMap<Hasher>> : std::true_type {};
+
+// >>> run=N, probes_per_lookup=X over the given maps (sampled lookups), for maps that count their probes
+template <typename AggMap>
+inline void probe_stats_print(const std::vector<std::vector<AggMap>> &agg_map_groups, int run_id, bool do_print_stats) {
+    if constexpr (counts_probes<AggMap>::value) {
+        uint64_t n_lookups = 0;
+        uint64_t n_probed_groups = 0;
+        for (const auto &agg_maps : agg_map_groups) {
+            for (const auto &agg_map : agg_maps) {
+                n_lookups += agg_map.n_lookups;
+                n_probed_groups += agg_map.n_probed_groups;
+            }
+        }
+        if (do_print_stats && n_lookups > 0) {
+            std::cout << ">>> run=" << run_id << ", probes_per_lookup=" << static_cast<double>(n_probed_groups) / n_lookups << std::endl;
+        }
+    }
+}
+
+template <typename AggMap>
+inline void probe_stats_print(const std::vector<AggMap> &agg_maps, int run_id, bool do_print_stats) {
+    if constexpr (counts_probes<AggMap>::value) {
+        probe_stats_print(std::vector<std::vector<AggMap>>{agg_maps}, run_id, do_print_stats);
+    }
+}
+
+// call fn with the hash function picked with --hash (xxh3 by default), so the algorithm can take its type as a
+// template argument: with_hasher(config, [&](auto hasher) { alg_impl<decltype(hasher)>(...); })
+// the hash is a runtime choice but the probe loops want it inlined, hence one instantiation per hash function
+template <typename Fn>
+inline void with_hasher(ExpConfig &config, Fn &&fn) {
+    if (config.hash == "xxh3") {
+        fn(I64Hasher{});
+    } else if (config.hash == "multiply-shift") {
+        fn(MultiplyShiftHasher{});
+    } else if (config.hash == "crc32c") {
+        fn(Crc32cHasher{});
+    } else if (config.hash == "murmur3") {
+        fn(Murmur3Hasher{});
+    } else {
+        throw std::runtime_error("Unsupported hash " + config.hash);
+    }
+}
+
+// call fn with a default constructed map of the backend picked with --map_backend, hashing with --hash, so the
+// algorithm can take its type as a template argument: with_agg_map_backend(config, [&](auto map) { alg_impl<decltype(map)>(...); })
+template <typename Fn>
+inline void with_agg_map_backend(ExpConfig &config, Fn &&fn) {
+    with_hasher(config, [&](auto hasher) {
+        typedef decltype(hasher) Hasher;
+        if (config.map_backend == "open-addressing") {
+            fn(AggMap<OpenAddressingMapBackend, Hasher>{});
+        } else if (config.map_backend == "swiss") {
+            fn(AggMap<SwissMapBackend, Hasher>{});
+        } else if (config.map_backend == "ska") {
+            fn(AggMap<SkaMapBackend, Hasher>{});
+        } else if (config.map_backend == "robin") {
+            fn(AggMap<RobinMapBackend, Hasher>{});
+        } else if (config.map_backend == "std") {
+            fn(AggMap<StdMapBackend, Hasher>{});
+        } else {
+            throw std::runtime_error("Unsupported map backend " + config.map_backend);
+        }
+    });
+}
+
+// every algorithm is compiled once per table layout (picked with --layout in main.cpp), list new layouts here
+#define INSTANTIATE_ALG_FOR_ALL_LAYOUTS(alg_fn) \
+    template void alg_fn<RowStore>(ExpConfig &config, RowStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res); \
+    template void alg_fn<ColumnStore>(ExpConfig &config, ColumnStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res); \
+    template void alg_fn<SegmentedStore>(ExpConfig &config, SegmentedStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res); \
+    template void alg_fn<PackedStore>(ExpConfig &config, PackedStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res)
+
+// define alg_fn<Table> as a call of the impl (the rest of the arguments, which may name Hasher) through with_hasher,
+// and instantiate it for all layouts, e.g. DEFINE_HASHED_ALG_FOR_ALL_LAYOUTS(sequential_sol, sequential_impl<Hasher>)
+#define DEFINE_HASHED_ALG_FOR_ALL_LAYOUTS(alg_fn, ...) \
+    template <typename Table> \
+    void alg_fn(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) { \
+        with_hasher(config, [&](auto hasher) { \
+            typedef decltype(hasher) Hasher; \
+            __VA_ARGS__(config, table, trial_idx, do_print_stats, agg_res); \
+        }); \
+    } \
+    INSTANTIATE_ALG_FOR_ALL_LAYOUTS(alg_fn)
+
+// using config specification, load stuff into table
+// for now, assume one group column, and group key column is not any of the value columns
+// a dataset path ending in .bin is read as a binary dataset, .zbin as a compressed one, csv goes through duckdb or,
+// with config.loader == "native", through our own parallel parser (csv.cpp)
+template <typename Table>
+void load_data(ExpConfig &config, Table &table);
+
+// native csv loading
+std::string read_text_file(const std::string &path, int num_threads);
+template <typename Table>
+void load_native_csv(ExpConfig &config, Table &table);
+
+// binary dataset io
+bool is_binary_dataset_path(const std::string &path);
+uint64_t compute_binary_checksum(ColumnStore &table);
+void write_binary_dataset(const std::string &path, ColumnStore &table);
+void map_binary_dataset(const std::string &path, ColumnStore &view, bool verify_checksum);
+void unmap_binary_dataset(ColumnStore &view);
+// rows per read (per column) when scanning a .bin with --io_engine uring, 512KB reads for int64 columns
+const int64_t DIRECT_IO_ROWS_PER_READ = 1 << 16;
+
+// compressed dataset io, the view keeps the file mapped and points into its header and directory
+struct CompressedDatasetView {
+    char *base = nullptr;
+    size_t file_size = 0;
+    CompressedDatasetHeader header;
+    const CompressedChunkEntry *entries = nullptr; // n_chunks * n_cols, chunk major
+    
+    inline int64_t chunk_row_lb(int64_t chunk_idx) const {
+        return chunk_idx * header.chunk_rows;
+    }
+    inline int64_t chunk_n_rows(int64_t chunk_idx) const {
+        return std::min<int64_t>(header.chunk_rows, header.n_rows - chunk_row_lb(chunk_idx));
+    }
+};
+bool is_compressed_dataset_path(const std::string &path);
+void write_compressed_dataset(const std::string &path, ColumnStore &table, int64_t chunk_rows, int num_threads);
+void map_compressed_dataset(const std::string &path, CompressedDatasetView &view);
+void unmap_compressed_dataset(CompressedDatasetView &view);
+// inflate one column of one chunk into dst (chunk_n_rows values), optionally checking its checksum
+void inflate_compressed_chunk(const CompressedDatasetView &view, int64_t chunk_idx, int col_idx, int64_t *dst, bool verify_checksum);
+
+// bounded blocking queue for handing work between threads, pop returns false once closed and drained
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity) {}
+    
+    void push(T item) {
+        std::unique_lock<std::mutex> lock(mtx);
+        not_full.wait(lock, [&] { return items.size() < capacity; });
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+    }
+    
+    bool pop(T &item) {
+        std::unique_lock<std::mutex> lock(mtx);
+        not_empty.wait(lock, [&] { return !items.empty() || closed; });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+    
+    void close() {
+        std::lock_guard<std::mutex> lock(mtx);
+        closed = true;
+        not_empty.notify_all();
+    }
+    
+private:
+    size_t capacity;
+    bool closed = false;
+    std::deque<T> items;
+    std::mutex mtx;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+};
+
+// streaming input: read the dataset batch by batch without materializing it
+// batches are RowStores of capacity config.stream_batch_rows whose n_rows is the filled row count,
+// taken from free_batches, filled, and handed to full_batches, which is closed at the end of input
+// a .zbin input is inflated by config.stream_decompress_threads threads of its own, one chunk at a time
+void stream_batches(ExpConfig &config, BoundedQueue<RowStore *> &free_batches, BoundedQueue<RowStore *> &full_batches);
+
+
+
+void time_print(std::string title, int run_id, chrono_time_point start, chrono_time_point end, bool do_print_stats);
+// n_bytes over the time between start and end, printed as MB/s next to the matching time_print line
+void throughput_print(std::string title, int run_id, uint64_t n_bytes, chrono_time_point start, chrono_time_point end, bool do_print_stats);
+std::unordered_map<int64_t, AggMapValue> load_valiadtion_data(ExpConfig &config);
+
+struct AggEntry
+{
+    std::atomic<int64_t> key;
+    std::atomic<int64_t> cnt;
+    std::atomic<int64_t> sum;
+    std::atomic<int64_t> min;
+    std::atomic<int64_t> max;
+    AggEntry() : key(INT64_MIN), cnt(0), sum(0), min(INT64_MAX), max(INT64_MIN) {}
+};
+
+struct AggEntrySnapshot
+{
+    int64_t key;
+    int64_t cnt;
+    int64_t sum;
+    int64_t min;
+    int64_t max;
+};
+
+// raw 64 byte aligned storage for n slots, constructed later (slots are trivially destructible)
+template <typename Slot>
+inline Slot *alloc_lock_free_slots(size_t n) {
+    return static_cast<Slot *>(::operator new(n * sizeof(Slot), std::align_val_t(64)));
+}
+
+template <typename Slot>
+inline void free_lock_free_slots(Slot *slots) {
+    ::operator delete(slots, std::align_val_t(64));
+}
+
+// entry layouts of GrowableLockFreeAggMap, picked with --lock_free_layout. each owns capacity slots, raw until
+// construct() runs over them. every slot has an atomic key that is claimed with a cas, the layouts differ in
+// where the four accumulators sit and how an update reaches them. store() is only used while migrating,
+// when no update runs, by the thread that claimed the key
+
+// atomic: AggEntry, five atomics in 40 bytes, so entries straddle cache lines, and an update is two
+// fetch_adds plus a cas loop each for min and max
+struct AtomicEntryLayout {
+    AggEntry *entries;
+
+    explicit AtomicEntryLayout(size_t capacity) : entries(alloc_lock_free_slots<AggEntry>(capacity)) {}
+    ~AtomicEntryLayout() { free_lock_free_slots(entries); }
+
+    void construct(size_t slot_lb, size_t slot_ub) {
+        for (size_t j = slot_lb; j < slot_ub; j++) {
+            new (&entries[j]) AggEntry();
+        }
+    }
+
+    std::atomic<int64_t> &key(size_t j) { return entries[j].key; }
+
+    inline bool accumulate(size_t j, int64_t cnt, int64_t sum, int64_t min, int64_t max) {
+        AggEntry &entry = entries[j];
+        entry.cnt.fetch_add(cnt, std::memory_order_relaxed);
+        entry.sum.fetch_add(sum, std::memory_order_relaxed);
+        int64_t cur_min = entry.min.load(std::memory_order_relaxed);
+        while (min < cur_min && !entry.min.compare_exchange_weak(cur_min, min, std::memory_order_relaxed));
+        int64_t cur_max = entry.max.load(std::memory_order_relaxed);
+        while (max > cur_max && !entry.max.compare_exchange_weak(cur_max, max, std::memory_order_relaxed));
+        return true;
+    }
+
+    AggEntrySnapshot snapshot(size_t j) const {
+        const AggEntry &entry = entries[j];
+        return AggEntrySnapshot{entry.key.load(std::memory_order_relaxed), entry.cnt.load(std::memory_order_relaxed), entry.sum.load(std::memory_order_relaxed),
+                                entry.min.load(std::memory_order_relaxed), entry.max.load(std::memory_order_relaxed)};
+    }
+
+    void store(size_t j, const AggEntrySnapshot &from) {
+        entries[j].cnt.store(from.cnt, std::memory_order_relaxed);
+        entries[j].sum.store(from.sum, std::memory_order_relaxed);
+        entries[j].min.store(from.min, std::memory_order_relaxed);
+        entries[j].max.store(from.max, std::memory_order_relaxed);
+    }
+};
+
+// bucket: keys in 64 byte buckets of 8, so a probe sequence scans a whole cache line of keys before it moves
+// on, and the accumulators in a side array of 32 byte aligned blocks that never straddle a line
+struct BucketLayout {
+    static constexpr size_t KEYS_PER_BUCKET = 8;
+
+    struct alignas(64) KeyBucket {
+        std::atomic<int64_t> keys[KEYS_PER_BUCKET];
+    };
+
+    struct alignas(32) Accumulators {
+        std::atomic<int64_t> cnt;
+        std::atomic<int64_t> sum;
+        std::atomic<int64_t> min;
+        std::atomic<int64_t> max;
+    };
+
+    KeyBucket *buckets;
+    Accumulators *accs;
+
+    // capacity is a power of two, at least MIN_CAPACITY, so it fills whole buckets
+    explicit BucketLayout(size_t capacity)
+        : buckets(alloc_lock_free_slots<KeyBucket>(capacity / KEYS_PER_BUCKET)), accs(alloc_lock_free_slots<Accumulators>(capacity)) {}
+    ~BucketLayout() {
+        free_lock_free_slots(buckets);
+        free_lock_free_slots(accs);
+    }
+
+    void construct(size_t slot_lb, size_t slot_ub) {
+        for (size_t j = slot_lb; j < slot_ub; j++) {
+            new (&buckets[j / KEYS_PER_BUCKET].keys[j % KEYS_PER_BUCKET]) std::atomic<int64_t>(INT64_MIN);
+            Accumulators *acc = new (&accs[j]) Accumulators();
+            acc->cnt.store(0, std::memory_order_relaxed);
+            acc->sum.store(0, std::memory_order_relaxed);
+            acc->min.store(INT64_MAX, std::memory_order_relaxed);
+            acc->max.store(INT64_MIN, std::memory_order_relaxed);
+        }
+    }
+
+    std::atomic<int64_t> &key(size_t j) { return buckets[j / KEYS_PER_BUCKET].keys[j % KEYS_PER_BUCKET]; }
+
+    inline bool accumulate(size_t j, int64_t cnt, int64_t sum, int64_t min, int64_t max) {
+        Accumulators &acc = accs[j];
+        acc.cnt.fetch_add(cnt, std::memory_order_relaxed);
+        acc.sum.fetch_add(sum, std::memory_order_relaxed);
+        int64_t cur_min = acc.min.load(std::memory_order_relaxed);
+        while (min < cur_min && !acc.min.compare_exchange_weak(cur_min, min, std::memory_order_relaxed));
+        int64_t cur_max = acc.max.load(std::memory_order_relaxed);
+        while (max > cur_max && !acc.max.compare_exchange_weak(cur_max, max, std::memory_order_relaxed));
+        return true;
+    }
+
+    AggEntrySnapshot snapshot(size_t j) {
+        const Accumulators &acc = accs[j];
+        return AggEntrySnapshot{key(j).load(std::memory_order_relaxed), acc.cnt.load(std::memory_order_relaxed), acc.sum.load(std::memory_order_relaxed),
+                                acc.min.load(std::memory_order_relaxed), acc.max.load(std::memory_order_relaxed)};
+    }
+
+    void store(size_t j, const AggEntrySnapshot &from) {
+        accs[j].cnt.store(from.cnt, std::memory_order_relaxed);
+        accs[j].sum.store(from.sum, std::memory_order_relaxed);
+        accs[j].min.store(from.min, std::memory_order_relaxed);
+        accs[j].max.store(from.max, std::memory_order_relaxed);
+    }
+};
+
+// packed: count, min and max narrowed to 32 + 16 + 16 bits and packed next to the 64 bit sum, so a single
+// 16 byte cas (cmpxchg16b, -march=native implies -mcx16) updates all four. only holds values that fit int16
+// and counts that fit uint32, like our generated datasets; accumulate() returns false for anything else
+struct PackedLayout {
+    __extension__ typedef unsigned __int128 uint128; // __extension__ keeps -Wpedantic quiet
+
+    struct alignas(32) Slot {
+        std::atomic<int64_t> key;
+        int64_t unused;
+        alignas(16) uint64_t acc[2]; // sum, then cnt << 32 | uint16(min) << 16 | uint16(max)
+    };
+
+    Slot *slots;
+
+    explicit PackedLayout(size_t capacity) : slots(alloc_lock_free_slots<Slot>(capacity)) {}
+    ~PackedLayout() { free_lock_free_slots(slots); }
+
+    static inline uint64_t pack(uint64_t cnt, int64_t min, int64_t max) {
+        return cnt << 32 | static_cast<uint64_t>(static_cast<uint16_t>(min)) << 16 | static_cast<uint16_t>(max);
+    }
+
+    void construct(size_t slot_lb, size_t slot_ub) {
+        for (size_t j = slot_lb; j < slot_ub; j++) {
+            Slot *slot = new (&slots[j]) Slot();
+            slot->key.store(INT64_MIN, std::memory_order_relaxed);
+            slot->acc[0] = 0;
+            slot->acc[1] = pack(0, INT16_MAX, INT16_MIN);
+        }
+    }
+
+    std::atomic<int64_t> &key(size_t j) { return slots[j].key; }
+
+    inline bool accumulate(size_t j, int64_t cnt, int64_t sum, int64_t min, int64_t max) {
+        if (min < INT16_MIN || max > INT16_MAX) {
+            return false;
+        }
+        uint128 *acc = reinterpret_cast<uint128 *>(slots[j].acc);
+        // the halves may tear, then the cas fails and hands back the real value
+        uint128 cur = static_cast<uint128>(__atomic_load_n(&slots[j].acc[1], __ATOMIC_RELAXED)) << 64 | __atomic_load_n(&slots[j].acc[0], __ATOMIC_RELAXED);
+        while (true) {
+            uint64_t cur_sum = static_cast<uint64_t>(cur);
+            uint64_t cur_packed = static_cast<uint64_t>(cur >> 64);
+            uint64_t new_cnt = (cur_packed >> 32) + cnt;
+            if (new_cnt > UINT32_MAX) {
+                return false;
+            }
+            int64_t new_min = std::min<int64_t>(static_cast<int16_t>(cur_packed >> 16), min);
+            int64_t new_max = std::max<int64_t>(static_cast<int16_t>(cur_packed), max);
+            uint128 next = static_cast<uint128>(pack(new_cnt, new_min, new_max)) << 64 | (cur_sum + static_cast<uint64_t>(sum));
+            uint128 seen = __sync_val_compare_and_swap(acc, cur, next);
+            if (seen == cur) {
+                return true;
+            }
+            cur = seen;
+        }
+    }
+
+    AggEntrySnapshot snapshot(size_t j) const {
+        const Slot &slot = slots[j];
+        int64_t cnt = static_cast<int64_t>(slot.acc[1] >> 32);
+        return AggEntrySnapshot{slot.key.load(std::memory_order_relaxed), cnt, static_cast<int64_t>(slot.acc[0]),
+                                cnt == 0 ? INT64_MAX : static_cast<int16_t>(slot.acc[1] >> 16), cnt == 0 ? INT64_MIN : static_cast<int16_t>(slot.acc[1])};
+    }
+
+    void store(size_t j, const AggEntrySnapshot &from) {
+        slots[j].acc[0] = static_cast<uint64_t>(from.sum);
+        slots[j].acc[1] = from.cnt == 0 ? pack(0, INT16_MAX, INT16_MIN) : pack(from.cnt, from.min, from.max);
+    }
+};
+
+// locked: a spinlock word per slot, all four accumulators updated with plain stores while holding it, so an
+// update is one atomic exchange and one store instead of an atomic per accumulator
+struct LockedLayout {
+    struct alignas(16) Slot {
+        std::atomic<int64_t> key;
+        std::atomic<uint32_t> lock;
+        int64_t cnt;
+        int64_t sum;
+        int64_t min;
+        int64_t max;
+    };
+
+    Slot *slots;
+
+    explicit LockedLayout(size_t capacity) : slots(alloc_lock_free_slots<Slot>(capacity)) {}
+    ~LockedLayout() { free_lock_free_slots(slots); }
+
+    void construct(size_t slot_lb, size_t slot_ub) {
+        for (size_t j = slot_lb; j < slot_ub; j++) {
+            Slot *slot = new (&slots[j]) Slot();
+            slot->key.store(INT64_MIN, std::memory_order_relaxed);
+            slot->lock.store(0, std::memory_order_relaxed);
+            slot->cnt = 0;
+            slot->sum = 0;
+            slot->min = INT64_MAX;
+            slot->max = INT64_MIN;
+        }
+    }
 
+    std::atomic<int64_t> &key(size_t j) { return slots[j].key; }
+
+    inline bool accumulate(size_t j, int64_t cnt, int64_t sum, int64_t min, int64_t max) {
+        Slot &slot = slots[j];
+        while (slot.lock.exchange(1, std::memory_order_acquire) != 0) {
+            while (slot.lock.load(std::memory_order_relaxed) != 0) {
+#if defined(__SSE2__)
+                _mm_pause();
+#endif
+            }
+        }
+        slot.cnt += cnt;
+        slot.sum += sum;
+        slot.min = std::min(slot.min, min);
+        slot.max = std::max(slot.max, max);
+        slot.lock.store(0, std::memory_order_release);
+        return true;
+    }
+
+    AggEntrySnapshot snapshot(size_t j) const {
+        const Slot &slot = slots[j];
+        return AggEntrySnapshot{slot.key.load(std::memory_order_relaxed), slot.cnt, slot.sum, slot.min, slot.max};
+    }
+
+    void store(size_t j, const AggEntrySnapshot &from) {
+        slots[j].cnt = from.cnt;
+        slots[j].sum = from.sum;
+        slots[j].min = from.min;
+        slots[j].max = from.max;
+    }
+};
+
+// lock-free linear probing agg map that grows instead of filling up. once the filled slots pass MAX_LOAD, the
+// thread that notices starts a migration into a table twice the size, and every thread that calls in helps:
+// first constructing blocks of the new table, then moving blocks of the old one, before it goes on.
+// a migration only starts moving once no thread is still inside an update of the old table (each caller
+// flags itself busy while it is in there), so the values it moves are final.
+// callers pass their thread id, ids are in [0, n_threads) and unique among threads updating at the same time.
+// Layout is one of the entry layouts above
+template <typename Hasher, typename Layout = AtomicEntryLayout>
+class GrowableLockFreeAggMap
+{
     public:
-        size_t size;
-        std::vector<AggEntry> data;
+        typedef Hasher hasher;
+        typedef Layout layout;
+
+        static constexpr float MAX_LOAD = 0.5f;
+        static constexpr size_t MIN_CAPACITY = 1024;
+        static constexpr size_t MIGRATION_BLOCK_SIZE = 4096;
+
+        GrowableLockFreeAggMap(size_t expected_groups, int n_threads)
+            : n_threads(n_threads), thread_states(n_threads) {
+            Table *table = new Table(capacity_for(expected_groups), n_threads);
+            size_t n_blocks = (table->capacity + MIGRATION_BLOCK_SIZE - 1) / MIGRATION_BLOCK_SIZE;
+            #pragma omp parallel for num_threads(n_threads) schedule(static)
+            for (size_t block_idx = 0; block_idx < n_blocks; block_idx++) {
+                table->slots.construct(block_idx * MIGRATION_BLOCK_SIZE, std::min(table->capacity, (block_idx + 1) * MIGRATION_BLOCK_SIZE));
+            }
+            current.store(table);
+        }
+
+        ~GrowableLockFreeAggMap() {
+            free_retired();
+            delete current.load();
+        }
+
+        GrowableLockFreeAggMap(const GrowableLockFreeAggMap &) = delete;
+        GrowableLockFreeAggMap &operator=(const GrowableLockFreeAggMap &) = delete;
+
+        inline void upsert(int tid, int64_t k, int64_t v) {
+            accumulate_from_accval_elems(tid, Hasher{}(k), k, 1, v, v, v);
+        }
+
+        // for callers that already hashed k with Hasher
+        inline void upsert(int tid, uint64_t hash, int64_t k, int64_t v) {
+            accumulate_from_accval_elems(tid, hash, k, 1, v, v, v);
+        }
+
+        inline void accumulate_from_accval(int tid, int64_t k, AggMapValue val) {
+            accumulate_from_accval_elems(tid, Hasher{}(k), k, val[0], val[1], val[2], val[3]);
+        }
+
+        inline void accumulate_from_accval_elems(int tid, int64_t k, int64_t cnt, int64_t sum, int64_t min, int64_t max) {
+            accumulate_from_accval_elems(tid, Hasher{}(k), k, cnt, sum, min, max);
+        }
+
+        void accumulate_from_accval_elems(int tid, uint64_t hash, int64_t k, int64_t cnt, int64_t sum, int64_t min, int64_t max) {
+            ThreadState &state = thread_states[tid];
+            while (true) {
+                state.busy.store(true, std::memory_order_seq_cst);
+                if (migration.load(std::memory_order_seq_cst) != nullptr) {
+                    state.busy.store(false, std::memory_order_release);
+                    help_migrate();
+                    continue;
+                }
+                Table *table = current.load(std::memory_order_acquire);
+                bool inserted_new = false;
+                bool fits = true;
+                bool done = table->accumulate(hash, k, cnt, sum, min, max, inserted_new, fits);
+                bool grow = !done;
+                if (!fits) {
+                    n_dropped_updates.fetch_add(1, std::memory_order_relaxed);
+                }
+
+                // filled slots are counted per thread and flushed in batches, so new keys do not all hit one counter
+                if (inserted_new) {
+                    if (state.counted_table != table) {
+                        state.counted_table = table;
+                        state.n_unflushed = 0;
+                    }
+                    if (++state.n_unflushed >= table->count_batch) {
+                        size_t n_filled = table->n_filled.fetch_add(state.n_unflushed, std::memory_order_relaxed) + state.n_unflushed;
+                        state.n_unflushed = 0;
+                        grow = n_filled >= table->grow_at;
+                    }
+                }
+                if (grow) {
+                    // still flagged busy, so the table cannot have been migrated away under us
+                    start_migration(table, table->capacity * 2);
+                }
+                state.busy.store(false, std::memory_order_release);
+                if (grow) {
+                    help_migrate();
+                }
+                if (done) {
+                    return;
+                }
+            }
+        }
+
+        // grow up front, all n_threads help move. call outside of parallel regions only
+        void reserve(size_t expected_groups) {
+            Table *table = current.load();
+            size_t want_capacity = capacity_for(expected_groups);
+            if (want_capacity > table->capacity) {
+                start_migration(table, want_capacity);
+                #pragma omp parallel num_threads(n_threads)
+                help_migrate();
+            }
+            free_retired();
+        }
+
+        // fn gets an AggEntrySnapshot per group. call once no thread updates anymore
+        // throws if the layout could not hold some update (values outside int16 in the packed layout)
+        template <typename Fn>
+        void for_each(Fn &&fn) {
+            throw_if_dropped_updates();
+            free_retired();
+            Table *table = current.load();
+            for (size_t j = 0; j < table->capacity; j++) {
+                if (table->slots.key(j).load(std::memory_order_relaxed) == INT64_MIN) continue;
+                fn(table->slots.snapshot(j));
+            }
+        }
+
+        // for_each does this too, call it first where for_each runs inside a parallel region
+        void throw_if_dropped_updates() const {
+            if (n_dropped_updates.load() > 0) {
+                throw std::runtime_error(std::to_string(n_dropped_updates.load()) + " updates did not fit the lock-free entry layout, use --lock_free_layout atomic");
+            }
+        }
+
+        size_t capacity() const { return current.load()->capacity; }
+        int n_migrations() const { return n_finished_migrations.load(); }
+
+    private:
+        struct Table {
+            size_t capacity;
+            size_t mask;
+            size_t grow_at;
+            int64_t count_batch;
+            Layout slots; // raw until the constructor or a migration constructs them
+            std::atomic<size_t> n_filled{0};
+
+            // overshoot from unflushed counts stays under capacity / 16
+            Table(size_t capacity, int n_threads)
+                : capacity(capacity), mask(capacity - 1), grow_at(static_cast<size_t>(capacity * MAX_LOAD)),
+                  count_batch(std::clamp<int64_t>(capacity / (16 * n_threads), 1, 64)), slots(capacity) {}
+
+            // false if the table is full and the update did not happen, fits is false if the layout could not hold it
+            inline bool accumulate(uint64_t hash, int64_t k, int64_t cnt, int64_t sum, int64_t min, int64_t max, bool &inserted_new, bool &fits) {
+                for (size_t probe = 0, j = hash & mask; probe < capacity; probe++, j = (j + 1) & mask) {
+                    std::atomic<int64_t> &key = slots.key(j);
+                    int64_t expected = key.load(std::memory_order_acquire);
+                    if (expected == INT64_MIN) {
+                        inserted_new = key.compare_exchange_strong(expected, k, std::memory_order_acq_rel, std::memory_order_acquire);
+                    }
+                    if (inserted_new || expected == k) {
+                        fits = slots.accumulate(j, cnt, sum, min, max);
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            // only called by migrating threads, every key shows up once, so the winner of the key cas owns the values
+            inline void insert_moved(uint64_t hash, const AggEntrySnapshot &from) {
+                for (size_t j = hash & mask;; j = (j + 1) & mask) {
+                    int64_t expected = INT64_MIN;
+                    if (slots.key(j).compare_exchange_strong(expected, from.key, std::memory_order_relaxed)) {
+                        slots.store(j, from);
+                        return;
+                    }
+                }
+            }
+        };
+
+        struct Migration {
+            Table *from;
+            Table *to;
+            size_t n_init_blocks;
+            size_t n_move_blocks;
+            std::atomic<size_t> next_init_block{0};
+            std::atomic<size_t> n_init_done{0};
+            std::atomic<size_t> next_move_block{0};
+            std::atomic<size_t> n_move_done{0};
+        };
+
+        struct alignas(64) ThreadState {
+            std::atomic<bool> busy{false};
+            Table *counted_table = nullptr;
+            int64_t n_unflushed = 0;
+        };
+
+        static size_t capacity_for(size_t expected_groups) {
+            size_t capacity = MIN_CAPACITY;
+            while (capacity * MAX_LOAD < expected_groups) {
+                capacity *= 2;
+            }
+            return capacity;
+        }
+
+        // loses quietly if another thread already started one
+        void start_migration(Table *from, size_t to_capacity) {
+            Migration *m = new Migration();
+            m->from = from;
+            m->to = new Table(to_capacity, n_threads);
+            m->n_init_blocks = (to_capacity + MIGRATION_BLOCK_SIZE - 1) / MIGRATION_BLOCK_SIZE;
+            m->n_move_blocks = (from->capacity + MIGRATION_BLOCK_SIZE - 1) / MIGRATION_BLOCK_SIZE;
+            Migration *expected = nullptr;
+            if (!migration.compare_exchange_strong(expected, m, std::memory_order_seq_cst)) {
+                delete m->to;
+                delete m;
+            }
+        }
+
+        void help_migrate() {
+            Migration *m = migration.load(std::memory_order_seq_cst);
+            if (m == nullptr) {
+                return;
+            }
+
+            // every thread still updating the old table started before the migration, wait until each has left once
+            for (ThreadState &state : thread_states) {
+                while (state.busy.load(std::memory_order_acquire) && migration.load(std::memory_order_acquire) == m) {
+                    std::this_thread::yield();
+                }
+            }
+
+            size_t block_idx;
+            while ((block_idx = m->next_init_block.fetch_add(1, std::memory_order_relaxed)) < m->n_init_blocks) {
+                m->to->slots.construct(block_idx * MIGRATION_BLOCK_SIZE, std::min(m->to->capacity, (block_idx + 1) * MIGRATION_BLOCK_SIZE));
+                m->n_init_done.fetch_add(1, std::memory_order_release);
+            }
+            while (m->n_init_done.load(std::memory_order_acquire) < m->n_init_blocks) {
+                std::this_thread::yield();
+            }
+
+            while ((block_idx = m->next_move_block.fetch_add(1, std::memory_order_relaxed)) < m->n_move_blocks) {
+                size_t slot_ub = std::min(m->from->capacity, (block_idx + 1) * MIGRATION_BLOCK_SIZE);
+                size_t n_moved = 0;
+                for (size_t i = block_idx * MIGRATION_BLOCK_SIZE; i < slot_ub; i++) {
+                    if (m->from->slots.key(i).load(std::memory_order_relaxed) == INT64_MIN) continue;
+                    AggEntrySnapshot entry = m->from->slots.snapshot(i);
+                    m->to->insert_moved(Hasher{}(entry.key), entry);
+                    n_moved++;
+                }
+                m->to->n_filled.fetch_add(n_moved, std::memory_order_relaxed);
+                if (m->n_move_done.fetch_add(1, std::memory_order_acq_rel) + 1 == m->n_move_blocks) {
+                    // last block in, publish the new table. the old one is freed once no thread can still hold it
+                    retired_tables.push_back(m->from);
+                    retired_migrations.push_back(m);
+                    n_finished_migrations.fetch_add(1, std::memory_order_relaxed);
+                    current.store(m->to, std::memory_order_seq_cst);
+                    migration.store(nullptr, std::memory_order_seq_cst);
+                }
+            }
+            while (migration.load(std::memory_order_acquire) == m) {
+                std::this_thread::yield();
+            }
+        }
+
+        void free_retired() {
+            for (Table *table : retired_tables) {
+                delete table;
+            }
+            for (Migration *m : retired_migrations) {
+                delete m;
+            }
+            retired_tables.clear();
+            retired_migrations.clear();
+        }
+
+        int n_threads;
+        std::vector<ThreadState> thread_states;
+        std::atomic<Table *> current{nullptr};
+        std::atomic<Migration *> migration{nullptr};
+        std::atomic<int> n_finished_migrations{0};
+        std::atomic<int64_t> n_dropped_updates{0};
+        // only touched by the thread finishing a migration, and outside parallel regions
+        std::vector<Table *> retired_tables;
+        std::vector<Migration *> retired_migrations;
 };
 
+template <typename T>
+struct type_tag {
+    typedef T type;
+};
+
+// call fn with the GrowableLockFreeAggMap type for the entry layout picked with --lock_free_layout, hashing with
+// --hash. the map needs a size and a thread count, so fn only gets its type:
+// with_lock_free_map(config, [&](auto map_type) { alg_impl<typename decltype(map_type)::type>(...); })
+template <typename Fn>
+inline void with_lock_free_map(ExpConfig &config, Fn &&fn) {
+    with_hasher(config, [&](auto hasher) {
+        typedef decltype(hasher) Hasher;
+        if (config.lock_free_layout == "atomic") {
+            fn(type_tag<GrowableLockFreeAggMap<Hasher, AtomicEntryLayout>>{});
+        } else if (config.lock_free_layout == "bucket") {
+            fn(type_tag<GrowableLockFreeAggMap<Hasher, BucketLayout>>{});
+        } else if (config.lock_free_layout == "packed") {
+            fn(type_tag<GrowableLockFreeAggMap<Hasher, PackedLayout>>{});
+        } else if (config.lock_free_layout == "locked") {
+            fn(type_tag<GrowableLockFreeAggMap<Hasher, LockedLayout>>{});
+        } else {
+            throw std::runtime_error("Unsupported lock-free layout " + config.lock_free_layout);
+        }
+    });
+}
 
 
 
+// heavy hitter layer for skewed keys (--heavy_hitters): every thread runs a Space-Saving sketch over a sample of
+// its rows, and a key that takes at least 1 / HOT_SHARE_INV of a sample window becomes hot for that thread.
+// rows of hot keys then go into a small thread-private accumulator instead of the shared table or radix
+// partition, so a few very frequent keys neither pile up on the same atomics nor make one partition a hotspot.
+// a key's earlier rows stay where they went, fold the hot accumulators in with for_each_hot at the end
+class HeavyHitterLayer {
+public:
+    static constexpr int SKETCH_SIZE = 64;
+    static constexpr int MAX_HOT_KEYS = 8;
+    static constexpr int SAMPLE_EVERY = 16; // rows
+    static constexpr int WINDOW = 1024; // sampled rows between promotions, the sketch restarts after each
+    // Space-Saving overcounts by at most WINDOW / SKETCH_SIZE, well below the WINDOW / HOT_SHARE_INV threshold
+    static constexpr int HOT_SHARE_INV = 16;
+
+    explicit HeavyHitterLayer(int n_threads) : sketches(n_threads) {}
+
+    // true if the row went into a hot accumulator, otherwise the caller aggregates it as usual
+    inline bool accumulate(int tid, int64_t key, int64_t val) {
+        ThreadSketch &s = sketches[tid];
+        for (int i = 0; i < s.n_hot; i++) {
+            if (s.hot_keys[i] == key) {
+                AggMapValue &acc = s.hot_accs[i];
+                acc[0] += 1;
+                acc[1] += val;
+                acc[2] = std::min(acc[2], val);
+                acc[3] = std::max(acc[3], val);
+                s.n_hot_rows++;
+                return true;
+            }
+        }
+        if (--s.rows_to_sample == 0) {
+            s.rows_to_sample = SAMPLE_EVERY;
+            s.observe(key);
+        }
+        return false;
+    }
+
+    // fn(key, acc) for every hot accumulator of thread tid
+    template <typename Fn>
+    void for_each_hot(int tid, Fn &&fn) const {
+        const ThreadSketch &s = sketches[tid];
+        for (int i = 0; i < s.n_hot; i++) {
+            fn(s.hot_keys[i], s.hot_accs[i]);
+        }
+    }
+
+    // fn(key, acc) for every hot accumulator of every thread, a key hot on several threads comes once per thread
+    template <typename Fn>
+    void for_each_hot(Fn &&fn) const {
+        for (int tid = 0; tid < static_cast<int>(sketches.size()); tid++) {
+            for_each_hot(tid, fn);
+        }
+    }
+
+    // one >>> run=N line each for heavy_hitter_rows and heavy_hitter_keys, summed over threads
+    void stats_print(int run_id, bool do_print_stats) const {
+        int64_t n_hot_rows = 0;
+        int n_hot_keys = 0;
+        for (const ThreadSketch &s : sketches) {
+            n_hot_rows += s.n_hot_rows;
+            n_hot_keys += s.n_hot;
+        }
+        if (do_print_stats) {
+            std::cout << ">>> run=" << run_id << ", heavy_hitter_rows=" << n_hot_rows << std::endl;
+            std::cout << ">>> run=" << run_id << ", heavy_hitter_keys=" << n_hot_keys << std::endl;
+        }
+    }
+
+private:
+    struct alignas(64) ThreadSketch {
+        int64_t sketch_keys[SKETCH_SIZE];
+        int64_t sketch_counts[SKETCH_SIZE];
+        int n_tracked = 0;
+        int n_sampled = 0;
+        int rows_to_sample = SAMPLE_EVERY;
+        int n_hot = 0;
+        int64_t hot_keys[MAX_HOT_KEYS];
+        AggMapValue hot_accs[MAX_HOT_KEYS];
+        int64_t n_hot_rows = 0;
+
+        // Space-Saving: count a tracked key, or replace the smallest counter and inherit its count
+        void observe(int64_t key) {
+            int min_idx = 0;
+            for (int i = 0; i < n_tracked; i++) {
+                if (sketch_keys[i] == key) {
+                    sketch_counts[i]++;
+                    min_idx = -1;
+                    break;
+                }
+                if (sketch_counts[i] < sketch_counts[min_idx]) {
+                    min_idx = i;
+                }
+            }
+            if (min_idx >= 0) {
+                if (n_tracked < SKETCH_SIZE) {
+                    sketch_keys[n_tracked] = key;
+                    sketch_counts[n_tracked] = 1;
+                    n_tracked++;
+                } else {
+                    sketch_keys[min_idx] = key;
+                    sketch_counts[min_idx]++;
+                }
+            }
+            if (++n_sampled == WINDOW) {
+                promote();
+            }
+        }
+
+        void promote() {
+            for (int i = 0; i < n_tracked && n_hot < MAX_HOT_KEYS; i++) {
+                if (sketch_counts[i] * HOT_SHARE_INV < WINDOW) {
+                    continue;
+                }
+                bool already_hot = false;
+                for (int h = 0; h < n_hot; h++) {
+                    already_hot |= hot_keys[h] == sketch_keys[i];
+                }
+                if (!already_hot) {
+                    hot_keys[n_hot] = sketch_keys[i];
+                    hot_accs[n_hot] = AggMapValue{0, 0, INT64_MAX, INT64_MIN};
+                    n_hot++;
+                }
+            }
+            n_tracked = 0;
+            n_sampled = 0;
+        }
+    };
+
+    std::vector<ThreadSketch> sketches;
+};
+
+
+// shared linear probing agg map behind lock stripes, for the striped-lock and optimistic hash table algorithms.
+// a key always falls in the same one of N_STRIPES stripes (top bits of its hash, so the table size does not
+// matter), and its four accumulators are only touched while that stripe is held, so an update is plain stores.
+// every stripe is a lock word on its own cache line.
+// with OPTIMISTIC the probe for a key runs before taking the stripe: keys never move or go away short of a
+// resize, and a resize swaps the table, so after taking the stripe only the table pointer is checked again.
+// otherwise the probe runs under the stripe too. new keys claim their slot with a cas either way, since keys of
+// other stripes probe the same slots.
+// growing takes every stripe in order and rehashes on one thread, so size it up front from a sample
+template <typename Hasher, bool OPTIMISTIC>
+class StripedAggMap
+{
+    public:
+        static constexpr size_t N_STRIPES = 1024;
+        static constexpr int STRIPE_SHIFT = 54; // 64 - log2(N_STRIPES)
+        static constexpr float MAX_LOAD = 0.5f;
+        static constexpr size_t MIN_CAPACITY = 16 * N_STRIPES;
+
+        StripedAggMap(size_t expected_groups, int n_threads) : stripes(N_STRIPES) {
+            Table *table = new Table(capacity_for(expected_groups));
+            #pragma omp parallel for num_threads(n_threads) schedule(static)
+            for (size_t j = 0; j < table->capacity; j++) {
+                table->construct(j);
+            }
+            current.store(table);
+        }
+
+        ~StripedAggMap() {
+            free_retired();
+            delete current.load();
+        }
+
+        StripedAggMap(const StripedAggMap &) = delete;
+        StripedAggMap &operator=(const StripedAggMap &) = delete;
+
+        void upsert(int64_t k, int64_t v) {
+            uint64_t hash = Hasher{}(k);
+            Stripe &stripe = stripes[hash >> STRIPE_SHIFT];
+            Table *table;
+            size_t j = NOT_FOUND;
+            if (OPTIMISTIC) {
+                while (true) {
+                    table = current.load(std::memory_order_acquire);
+                    j = table->find(hash, k);
+                    lock(stripe);
+                    if (current.load(std::memory_order_relaxed) == table) break;
+                    unlock(stripe);
+                }
+            } else {
+                lock(stripe);
+                table = current.load(std::memory_order_relaxed);
+            }
+
+            bool grow = false;
+            if (j == NOT_FOUND) {
+                bool claimed = false;
+                j = table->find_or_claim(hash, k, claimed);
+                grow = claimed && ++stripe.n_filled >= table->stripe_grow_at;
+            }
+            Slot &slot = table->slots[j];
+            slot.cnt += 1;
+            slot.sum += v;
+            slot.min = std::min(slot.min, v);
+            slot.max = std::max(slot.max, v);
+            unlock(stripe);
+
+            if (grow) {
+                resize(table);
+            }
+        }
+
+        // fn gets an AggEntrySnapshot per group. call once no thread updates anymore
+        template <typename Fn>
+        void for_each(Fn &&fn) {
+            free_retired();
+            Table *table = current.load();
+            for (size_t j = 0; j < table->capacity; j++) {
+                const Slot &slot = table->slots[j];
+                if (slot.key.load(std::memory_order_relaxed) == INT64_MIN) continue;
+                fn(AggEntrySnapshot{slot.key.load(std::memory_order_relaxed), slot.cnt, slot.sum, slot.min, slot.max});
+            }
+        }
+
+        size_t capacity() const { return current.load()->capacity; }
+        int n_resizes() const { return n_finished_resizes; }
+
+    private:
+        static constexpr size_t NOT_FOUND = SIZE_MAX;
+
+        struct Slot {
+            std::atomic<int64_t> key;
+            int64_t cnt;
+            int64_t sum;
+            int64_t min;
+            int64_t max;
+        };
+
+        struct alignas(64) Stripe {
+            std::atomic<uint32_t> lock{0};
+            size_t n_filled = 0; // slots claimed by keys of this stripe, only touched under its lock
+        };
+
+        struct Table {
+            size_t capacity;
+            size_t mask;
+            size_t stripe_grow_at; // every stripe stays under its share, so the table stays under MAX_LOAD
+            Slot *slots;
+
+            explicit Table(size_t capacity)
+                : capacity(capacity), mask(capacity - 1), stripe_grow_at(static_cast<size_t>(capacity * MAX_LOAD) / N_STRIPES),
+                  slots(alloc_lock_free_slots<Slot>(capacity)) {}
+            ~Table() { free_lock_free_slots(slots); }
+
+            void construct(size_t j) {
+                Slot *slot = new (&slots[j]) Slot();
+                slot->key.store(INT64_MIN, std::memory_order_relaxed);
+                slot->cnt = 0;
+                slot->sum = 0;
+                slot->min = INT64_MAX;
+                slot->max = INT64_MIN;
+            }
+
+            // the table is never more than half full, so the probe always reaches k or an empty slot
+            inline size_t find(uint64_t hash, int64_t k) const {
+                for (size_t j = hash & mask;; j = (j + 1) & mask) {
+                    int64_t key = slots[j].key.load(std::memory_order_acquire);
+                    if (key == k) return j;
+                    if (key == INT64_MIN) return NOT_FOUND;
+                }
+            }
+
+            // under k's stripe, so no other thread inserts k at the same time
+            inline size_t find_or_claim(uint64_t hash, int64_t k, bool &claimed) {
+                for (size_t j = hash & mask;; j = (j + 1) & mask) {
+                    int64_t key = slots[j].key.load(std::memory_order_acquire);
+                    if (key == INT64_MIN) {
+                        claimed = slots[j].key.compare_exchange_strong(key, k, std::memory_order_acq_rel, std::memory_order_acquire);
+                        if (claimed) return j;
+                    }
+                    if (key == k) return j;
+                }
+            }
+        };
+
+        static size_t capacity_for(size_t expected_groups) {
+            size_t capacity = MIN_CAPACITY;
+            while (capacity * MAX_LOAD < expected_groups) {
+                capacity *= 2;
+            }
+            return capacity;
+        }
+
+        static inline void lock(Stripe &stripe) {
+            while (stripe.lock.exchange(1, std::memory_order_acquire) != 0) {
+                while (stripe.lock.load(std::memory_order_relaxed) != 0) {
+#if defined(__SSE2__)
+                    _mm_pause();
+#endif
+                }
+            }
+        }
+
+        static inline void unlock(Stripe &stripe) {
+            stripe.lock.store(0, std::memory_order_release);
+        }
+
+        // stripes are taken in order and every other caller holds at most one, so this cannot deadlock.
+        // optimistic probes may still be reading the old table, it is only freed once updates are over
+        void resize(Table *seen) {
+            for (Stripe &stripe : stripes) {
+                lock(stripe);
+            }
+            if (current.load(std::memory_order_relaxed) == seen) {
+                Table *table = new Table(seen->capacity * 2);
+                for (size_t j = 0; j < table->capacity; j++) {
+                    table->construct(j);
+                }
+                for (size_t i = 0; i < seen->capacity; i++) {
+                    const Slot &from = seen->slots[i];
+                    int64_t key = from.key.load(std::memory_order_relaxed);
+                    if (key == INT64_MIN) continue;
+                    bool claimed = false;
+                    Slot &to = table->slots[table->find_or_claim(Hasher{}(key), key, claimed)];
+                    to.cnt = from.cnt;
+                    to.sum = from.sum;
+                    to.min = from.min;
+                    to.max = from.max;
+                }
+                retired_tables.push_back(seen);
+                n_finished_resizes++;
+                current.store(table, std::memory_order_release);
+            }
+            for (Stripe &stripe : stripes) {
+                unlock(stripe);
+            }
+        }
+
+        void free_retired() {
+            for (Table *table : retired_tables) {
+                delete table;
+            }
+            retired_tables.clear();
+        }
+
+        std::vector<Stripe> stripes;
+        std::atomic<Table *> current{nullptr};
+        // only touched while holding every stripe, and outside parallel regions
+        int n_finished_resizes = 0;
+        std::vector<Table *> retired_tables;
+};
+
+
+// single producer single consumer ring of CAPACITY (a power of two) items, for handing rows between two threads
+// without locks. the producer pushes a batch at a time and the consumer takes whatever is in the ring at once;
+// each side keeps a copy of the other's index and only reads the shared one when the ring looks full or empty.
+// items are left uninitialized until pushed, so a large array of rings only costs the pages it uses
+template <typename T, size_t CAPACITY>
+class SpscRing {
+public:
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "ring capacity must be a power of two");
+
+    // pushes all n items, or none if they do not fit. producer only
+    inline bool try_push(const T *items, size_t n) {
+        size_t tail = producer.tail.load(std::memory_order_relaxed);
+        if (tail + n - producer.cached_head > CAPACITY) {
+            producer.cached_head = consumer.head.load(std::memory_order_acquire);
+            if (tail + n - producer.cached_head > CAPACITY) {
+                return false;
+            }
+        }
+        for (size_t i = 0; i < n; i++) {
+            slots[(tail + i) & (CAPACITY - 1)] = items[i];
+        }
+        producer.tail.store(tail + n, std::memory_order_release);
+        return true;
+    }
+
+    // calls fn on every item in the ring, returns how many. consumer only
+    template <typename Fn>
+    inline size_t pop_all(Fn &&fn) {
+        size_t head = consumer.head.load(std::memory_order_relaxed);
+        if (head == consumer.cached_tail) {
+            consumer.cached_tail = producer.tail.load(std::memory_order_acquire);
+            if (head == consumer.cached_tail) {
+                return 0;
+            }
+        }
+        size_t tail = consumer.cached_tail;
+        for (size_t i = head; i != tail; i++) {
+            fn(slots[i & (CAPACITY - 1)]);
+        }
+        consumer.head.store(tail, std::memory_order_release);
+        return tail - head;
+    }
+
+private:
+    struct alignas(64) Producer {
+        std::atomic<size_t> tail{0};
+        size_t cached_head = 0;
+    };
+    struct alignas(64) Consumer {
+        std::atomic<size_t> head{0};
+        size_t cached_tail = 0;
+    };
+
+    Producer producer;
+    Consumer consumer;
+    alignas(64) T slots[CAPACITY];
+};
+
+
 inline float expected_g(float k, float G);
 float estimate_G(float k, float g_tilde);
 
+// rows sampled at an even stride to guess the number of groups before sizing a shared table
+const int64_t GROUP_COUNT_SAMPLE_ROWS = 10000;
+
+// distinct keys of a strided sample of the table, and estimate_G over them
+struct GroupCountSample {
+    ska::flat_hash_map<int64_t, int64_t> sample_map;
+    float G_hat = 0.0f;
+};
+
+// empty (G_hat 0) when the table has fewer than two rows to sample
+template <typename Table>
+inline GroupCountSample sample_group_keys(Table &table) {
+    GroupCountSample sample;
+    int64_t n_sampled_row = std::min<int64_t>(GROUP_COUNT_SAMPLE_ROWS, table.n_rows);
+    if (n_sampled_row < 2) {
+        return sample;
+    }
+    int64_t stride = table.n_rows / n_sampled_row;
+    for (int64_t i = 0; i < n_sampled_row; i++) {
+        sample.sample_map[table.get(i * stride, 0)] = 0;
+    }
+    sample.G_hat = estimate_G(static_cast<float>(n_sampled_row), static_cast<float>(sample.sample_map.size()));
+    return sample;
+}
+
+// estimate_G over a strided sample, capped at the row count since a saturated sample overshoots
+template <typename Table>
+inline size_t sample_group_count(Table &table) {
+    GroupCountSample sample = sample_group_keys(table);
+    if (sample.sample_map.empty()) {
+        return table.n_rows;
+    }
+    return std::min<size_t>(static_cast<size_t>(sample.G_hat) + 1, table.n_rows);
+}
+
+// sample_group_count split over hash partitions: the estimate for the whole table, shared out by how many of the
+// sampled groups hash into each partition
+template <typename Hasher, typename Table>
+inline std::vector<size_t> sample_partition_group_counts(Table &table, size_t n_partitions) {
+    GroupCountSample sample = sample_group_keys(table);
+    if (sample.sample_map.empty()) {
+        return std::vector<size_t>(n_partitions, table.n_rows);
+    }
+    std::vector<size_t> n_sampled_groups(n_partitions, 0);
+    for (auto &entry : sample.sample_map) {
+        n_sampled_groups[hash_partition(Hasher{}(entry.first), n_partitions)]++;
+    }
+    std::vector<size_t> group_counts(n_partitions);
+    for (size_t part_idx = 0; part_idx < n_partitions; part_idx++) {
+        float share = static_cast<float>(n_sampled_groups[part_idx]) / static_cast<float>(sample.sample_map.size());
+        group_counts[part_idx] = std::min<size_t>(static_cast<size_t>(sample.G_hat * share) + 1, table.n_rows);
+    }
+    return group_counts;
+}
+
 // float central_merge_cost_model(float G, int S_int, int p_int);
 // float tree_merge_cost_model(float G, int S_int, int p_int);
 // float radix_merge_cost_model(float G, int S_int, int p_int);
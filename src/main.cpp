@@ -3,6 +3,7 @@
 #include <csignal>
 #include <ctime>
 #include <duckdb.hpp>
+#include <filesystem>
 #include <iostream>
 #include <omp.h>
 #include <string>
@@ -31,6 +32,93 @@ void print_agg_stats(std::vector<AggResRow> agg_res) {
     std::cout << ">> output has " << agg_res.size() << " rows" << std::endl;
 }
 
+// dryruns, then timed trials, then validate the last trial's output
+void run_trials(ExpConfig &config, std::function<void(int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res)> run_once) {
+    std::vector<AggResRow> agg_res; // where to write results to
+    
+    std::cout << "Running " << config.num_dryruns << " warm-up iteration(s) to stabilize performance" << std::endl;
+    for (int dryrun_idx = 0; dryrun_idx < config.num_dryruns; dryrun_idx++) {
+        agg_res.clear();
+        printf(">> --- running dryrun %d ---\n", dryrun_idx);
+        run_once(dryrun_idx, false, agg_res);
+    }
+
+    std::cout << "Running " << config.num_trials << " evaluation iteration(s) for benchmarking" << std::endl;
+    for (int trial_idx = 0; trial_idx < config.num_trials; trial_idx++) {
+        printf(">> --- running trial %d ---\n", trial_idx);
+        agg_res.clear();
+        run_once(trial_idx, true, agg_res);
+    }
+        
+    std::cout << "Validating results against reference" << std::endl;
+    auto reference_agg_map = load_valiadtion_data(config);
+    validate_results(agg_res, reference_agg_map);
+    std::cout << "Validation passes" << std::endl;
+}
+
+template <typename Table>
+void run_experiment(ExpConfig &config) {
+    // load the data into the chosen layout
+    
+    Table table;
+    chrono_time_point t_load_0 = std::chrono::steady_clock::now();
+    load_data(config, table);
+    chrono_time_point t_load_1 = std::chrono::steady_clock::now();
+    time_print("load_time", 0, t_load_0, t_load_1, true);
+    throughput_print("load_throughput", 0, std::filesystem::file_size(config.dataset_file_path), t_load_0, t_load_1, true);
+    std::cout << "loaded data into memory" << std::endl;
+    
+    std::function<void(ExpConfig &config, Table &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res)> selected_alg;
+    
+    if (config.algorithm == "sequential") {
+        selected_alg = sequential_sol<Table>;
+    } else if (config.algorithm == "two-phase-central-merge" || config.algorithm == "two-phase-central-merge-xxhash") {
+        // the -xxhash names predate --map_backend and --hash, they run the same algorithm
+        selected_alg = two_phase_centralised_merge_sol<Table>;
+    } else if (config.algorithm == "two-phase-tree-merge") {
+        selected_alg = two_phase_tree_merge_sol<Table>;
+    } else if (config.algorithm == "global-lock") {
+        selected_alg = global_lock_sol<Table>;
+    } else if (config.algorithm == "two-phase-radix" || config.algorithm == "two-phase-radix-xxhash") {
+        selected_alg = two_phase_radix_sol<Table>;
+    } else if (config.algorithm == "swwc-radix") {
+        selected_alg = swwc_radix_sol<Table>;
+    } else if (config.algorithm == "duckdbish-two-phase") {
+        selected_alg = duckdbish_two_phase_sol<Table>;
+    } else if (config.algorithm == "implicit-repartitioning") {
+        selected_alg = implicit_repartitioning_sol<Table>;
+    } else if (config.algorithm == "delegation") {
+        selected_alg = delegation_sol<Table>;
+    } else if (config.algorithm == "three-phase-radix") {
+        selected_alg = three_phase_radix_sol<Table>;
+    } else if (config.algorithm == "omp-lock-free-hash-table") {
+        selected_alg = omp_lock_free_hash_table_sol<Table>;
+    } else if (config.algorithm == "lock-free-hash-table") {
+        selected_alg = lock_free_hash_table_sol<Table>;
+    } else if (config.algorithm == "partitioned-lock-free-hash-table") {
+        selected_alg = partitioned_lock_free_hash_table_sol<Table>;
+    } else if (config.algorithm == "striped-lock-hash-table") {
+        selected_alg = striped_lock_hash_table_sol<Table>;
+    } else if (config.algorithm == "optimistic-hash-table") {
+        selected_alg = optimistic_hash_table_sol<Table>;
+    } else if (config.algorithm == "adaptive-alg1") {
+        selected_alg = adaptive_alg1_sol<Table>;
+    } else if (config.algorithm == "adaptive-alg2") {
+        selected_alg = adaptive_alg2_sol<Table>;
+    } else if (config.algorithm == "adaptive-alg3") {
+        selected_alg = adaptive_alg3_sol<Table>;
+    } else if (config.algorithm == "adaptive-alg4") {
+        selected_alg = adaptive_alg4_sol<Table>;
+    } else {
+        throw std::runtime_error("Unsupported algorithm");
+    }
+    
+    // 3 > run the experiment
+    run_trials(config, [&](int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
+        selected_alg(config, table, trial_idx, do_print_stats, agg_res);
+    });
+}
+
 int main(int argc, char *argv[]) {
 
     // int n_sampled_row = 1110000;
@@ -52,8 +140,22 @@ int main(int argc, char *argv[]) {
     config.batch_size = 10000;
     config.duckdb_style_adaptation_threshold = 10000;
     config.algorithm = "SEQUENTIAL";
+    config.layout = "row";
     config.dataset_file_path = "data/exponential/100K-1K.csv.gz";
     config.validation_file_path = "data/exponential/val-100K-1K.csv.gz";
+    config.verify_checksum = false;
+    config.loader = "duckdb";
+    config.streaming = false;
+    config.stream_batch_rows = 64 * 1024;
+    config.stream_max_batches = -1; // -1 means 2 batches per thread
+    config.stream_decompress_threads = -1; // -1 means a quarter of num_threads, at least 1
+    config.io_engine = "mmap";
+    config.io_queue_depth = 32;
+    config.map_backend = "open-addressing";
+    config.map_load_factor = 0.5f;
+    config.hash = "xxh3";
+    config.lock_free_layout = "atomic";
+    config.heavy_hitters = false;
     config.in_table_name = "lineitem";
     // for our own generated dataset, there's only a key column and a val column:
     config.group_key_col_name = "key";
@@ -70,78 +172,54 @@ int main(int argc, char *argv[]) {
     app.add_option("--batch_size", config.batch_size);
     std::string strat_str = "SEQUENTIAL";
     app.add_option("--algorithm", config.algorithm);
-    app.add_option("--dataset_file_path", config.dataset_file_path, "Path to the gzipped CSV input file (with two integer columns)")->check(CLI::ExistingFile)->required();
+    app.add_option("--layout", config.layout, "Table layout to aggregate over: row (key and val interleaved), column, or segmented (column chunks allocated independently, for billion-row inputs), or packed (frame of reference + bit packed columns, decoded during the scan)")->check(CLI::IsMember({"row", "column", "segmented", "packed"}));
+    app.add_option("--dataset_file_path", config.dataset_file_path, "Path to the gzipped CSV input file (with two integer columns), or a .bin/.zbin dataset made by ./convert")->check(CLI::ExistingFile)->required();
     app.add_option("--validation_file_path", config.validation_file_path, "Path to sampled reference results")->check(CLI::ExistingFile)->required();
+    app.add_option("--loader", config.loader, "How to load a csv dataset: duckdb, or native (our own parallel simd parser)")->check(CLI::IsMember({"duckdb", "native"}));
+    app.add_flag("--verify_checksum", config.verify_checksum, "Verify the checksum of a .bin dataset before running (with --io_engine uring only for the column and packed layouts)");
+    app.add_flag("--streaming", config.streaming, "Aggregate batches as they are read instead of loading the whole table first");
+    app.add_option("--stream_batch_rows", config.stream_batch_rows, "Rows per batch in --streaming mode");
+    app.add_option("--stream_max_batches", config.stream_max_batches, "Max batches buffered at once in --streaming mode (default 2 per thread)");
+    app.add_option("--stream_decompress_threads", config.stream_decompress_threads, "Threads inflating a .zbin dataset in --streaming mode, on top of --num_threads aggregating (default num_threads / 4)");
+    app.add_option("--io_engine", config.io_engine, "How to read a .bin dataset: mmap, or uring (O_DIRECT reads through io_uring, bypassing the page cache)")->check(CLI::IsMember({"mmap", "uring"}));
+    app.add_option("--io_queue_depth", config.io_queue_depth, "Reads kept in flight with --io_engine uring");
+    app.add_option("--map_backend", config.map_backend, "Local hash map of the two-phase algorithms: open-addressing (ours, single probe upsert), swiss (ours, sse2 tag probing, reports probes per lookup), ska (ska::flat_hash_map), robin (tsl::robin_map), or std (std::unordered_map)")->check(CLI::IsMember({"open-addressing", "swiss", "ska", "robin", "std"}));
+    app.add_option("--map_load_factor", config.map_load_factor, "Max load factor of the open-addressing map before it doubles")->check(CLI::Range(0.1f, 0.95f));
+    app.add_option("--hash", config.hash, "Hash function of the group keys, in every map and for picking radix partitions: xxh3, multiply-shift, crc32c (sse4.2 / armv8 crc instruction), or murmur3 (murmur3's fmix64 finalizer)")->check(CLI::IsMember({"xxh3", "multiply-shift", "crc32c", "murmur3"}));
+    app.add_option("--lock_free_layout", config.lock_free_layout, "Entry layout of the shared lock-free table: atomic (five atomics per entry), bucket (keys 8 per cache line, accumulators aside), packed (narrow accumulators updated by one 16 byte cas, int16 values only), or locked (spinlock per slot, plain stores)")->check(CLI::IsMember({"atomic", "bucket", "packed", "locked"}));
+    app.add_flag("--heavy_hitters", config.heavy_hitters, "Detect very frequent keys during the scan (Space-Saving per thread) and aggregate their rows in thread-private accumulators: lock-free, radix and adaptive-alg4 algorithms");
     app.add_option("--in_table_name", config.in_table_name);
     
     CLI11_PARSE(app, argc, argv);
+    if (config.stream_max_batches <= 0) {
+        config.stream_max_batches = 2 * config.num_threads;
+    }
+    if (config.stream_decompress_threads <= 0) {
+        config.stream_decompress_threads = std::max(1, config.num_threads / 4);
+    }
+
+    open_addressing_max_load_factor = config.map_load_factor;
 
     config.display();
     
-    // 2 > load the data
+    // 2 > load the data and run, with the table layout picked at compile time per instantiation
     
-    RowStore table;
-    load_data(config, table);
-    std::cout << "loaded data into memory" << std::endl;
-    std::vector<AggResRow> agg_res; // where to write results to
-    
-    std::function<void(ExpConfig &config, RowStore &table, int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res)> selected_alg;
-    
-    if (config.algorithm == "sequential") {
-        selected_alg = sequential_sol;
-    } else if (config.algorithm == "two-phase-central-merge") {
-        selected_alg = two_phase_centralised_merge_sol;
-    } else if (config.algorithm == "two-phase-tree-merge") {
-        selected_alg = two_phase_tree_merge_sol;
-    } else if (config.algorithm == "two-phase-central-merge-xxhash") {
-        selected_alg = two_phase_centralised_merge_xxhash_sol;
-    } else if (config.algorithm == "global-lock") {
-        selected_alg = global_lock_sol;
-    } else if (config.algorithm == "two-phase-radix") {
-        selected_alg = two_phase_radix_sol;
-    } else if (config.algorithm == "two-phase-radix-xxhash") {
-        selected_alg = two_phase_radix_xxhash_sol;
-    } else if (config.algorithm == "duckdbish-two-phase") {
-        selected_alg = duckdbish_two_phase_sol;
-    } else if (config.algorithm == "implicit-repartitioning") {
-        selected_alg = implicit_repartitioning_sol;
-    } else if (config.algorithm == "three-phase-radix") {
-        selected_alg = three_phase_radix_sol;
-    } else if (config.algorithm == "omp-lock-free-hash-table") {
-        selected_alg = omp_lock_free_hash_table_sol;
-    } else if (config.algorithm == "lock-free-hash-table") {
-        selected_alg = lock_free_hash_table_sol;
-    } else if (config.algorithm == "adaptive-alg1") {
-        selected_alg = adaptive_alg1_sol;
-    } else if (config.algorithm == "adaptive-alg2") {
-        selected_alg = adaptive_alg2_sol;
-    } else if (config.algorithm == "adaptive-alg3") {
-        selected_alg = adaptive_alg3_sol;
-    } else if (config.algorithm == "adaptive-alg4") {
-        selected_alg = adaptive_alg4_sol;
+    if (config.streaming) {
+        // nothing gets loaded up front, every trial reads the input again
+        run_trials(config, [&](int trial_idx, bool do_print_stats, std::vector<AggResRow> &agg_res) {
+            streaming_sol(config, trial_idx, do_print_stats, agg_res);
+        });
+    } else if (config.layout == "row") {
+        run_experiment<RowStore>(config);
+    } else if (config.layout == "column") {
+        run_experiment<ColumnStore>(config);
+    } else if (config.layout == "segmented") {
+        run_experiment<SegmentedStore>(config);
+    } else if (config.layout == "packed") {
+        run_experiment<PackedStore>(config);
     } else {
-        throw std::runtime_error("Unsupported algorithm");
-    }
-    
-    // 3 > run the experiment
-    std::cout << "Running " << config.num_dryruns << " warm-up iteration(s) to stabilize performance" << std::endl;
-    for (int dryrun_idx = 0; dryrun_idx < config.num_dryruns; dryrun_idx++) {
-        agg_res.clear();
-        printf(">> --- running dryrun %d ---\n", dryrun_idx);
-        selected_alg(config, table, dryrun_idx, false, agg_res);
-    }
-
-    std::cout << "Running " << config.num_trials << " evaluation iteration(s) for benchmarking" << std::endl;
-    for (int trial_idx = 0; trial_idx < config.num_trials; trial_idx++) {
-        printf(">> --- running trial %d ---\n", trial_idx);
-        agg_res.clear();
-        selected_alg(config, table, trial_idx, true, agg_res);
+        throw std::runtime_error("Unsupported layout");
     }
-        
-    std::cout << "Validating results against reference" << std::endl;
-    auto reference_agg_map = load_valiadtion_data(config);
-    validate_results(agg_res, reference_agg_map);
-    std::cout << "Validation passes" << std::endl;
     
     return 0;
 }
\ No newline at end of file
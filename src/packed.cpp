@@ -0,0 +1,98 @@
+//! PackedStore encoding and batch decoding, see lib.hpp
+
+#include "lib.hpp"
+#include <cstdlib>
+#include <omp.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+void PackedStore::pack_from(ColumnStore &src, int num_threads) {
+    n_cols = src.n_cols;
+    n_rows = src.n_rows;
+    columns.resize(n_cols);
+    int64_t n_blocks = (n_rows + 63) / 64;
+
+    omp_set_num_threads(num_threads);
+    for (int c = 0; c < n_cols; c++) {
+        const int64_t *values = &src.data[src.get_idx(0, c)];
+
+        // frame of reference: the column minimum, width: enough bits for max - min
+        int64_t col_min = INT64_MAX;
+        int64_t col_max = INT64_MIN;
+        #pragma omp parallel for schedule(static) reduction(min: col_min) reduction(max: col_max)
+        for (int64_t r = 0; r < n_rows; r++) {
+            col_min = std::min(col_min, values[r]);
+            col_max = std::max(col_max, values[r]);
+        }
+        PackedColumn &col = columns[c];
+        col.base = n_rows > 0 ? col_min : 0;
+        uint64_t range = n_rows > 0 ? static_cast<uint64_t>(col_max) - static_cast<uint64_t>(col_min) : 0;
+        col.width = range == 0 ? 0 : 64 - __builtin_clzll(range);
+        if (col.width > MAX_PACKED_WIDTH) {
+            col.width = 64;
+        }
+        col.mask = col.width == 64 ? ~0ULL : (1ULL << col.width) - 1;
+        col.words = new uint64_t[n_blocks * col.width + 1]();
+
+        // every block of 64 rows fills exactly width words, so blocks pack independently
+        #pragma omp parallel for schedule(static)
+        for (int64_t block_idx = 0; block_idx < n_blocks; block_idx++) {
+            if (col.width == 0) {
+                continue;
+            }
+            uint64_t *out = &col.words[block_idx * col.width];
+            int64_t row_ub = std::min(n_rows, (block_idx + 1) * 64);
+            uint64_t acc = 0;
+            int acc_bits = 0;
+            for (int64_t r = block_idx * 64; r < row_ub; r++) {
+                uint64_t code = static_cast<uint64_t>(values[r]) - static_cast<uint64_t>(col.base);
+                acc |= code << acc_bits;
+                acc_bits += col.width;
+                if (acc_bits >= 64) {
+                    *out++ = acc;
+                    acc_bits -= 64;
+                    acc = acc_bits == 0 ? 0 : code >> (col.width - acc_bits);
+                }
+            }
+            if (acc_bits > 0) {
+                *out = acc;
+            }
+        }
+    }
+}
+
+void PackedStore::read_column_chunk(int64_t row_idx, int col_idx, int64_t *dst, int64_t n) {
+    const PackedColumn &col = columns[col_idx];
+    const char *bytes = reinterpret_cast<const char *>(col.words);
+    int64_t i = 0;
+#if defined(__AVX2__)
+    // 4 rows per step: gather the 8 bytes holding each value, shift it down, mask, add the base
+    const __m256i mask = _mm256_set1_epi64x(col.mask);
+    const __m256i base = _mm256_set1_epi64x(col.base);
+    const __m256i seven = _mm256_set1_epi64x(7);
+    const __m256i step = _mm256_set1_epi64x(4 * col.width);
+    int64_t bit = row_idx * col.width;
+    __m256i bits = _mm256_setr_epi64x(bit, bit + col.width, bit + 2 * col.width, bit + 3 * col.width);
+    for (; i + 4 <= n; i += 4) {
+        __m256i byte_offsets = _mm256_srli_epi64(bits, 3);
+        __m256i shifts = _mm256_and_si256(bits, seven);
+        __m256i words = _mm256_i64gather_epi64(reinterpret_cast<const long long *>(bytes), byte_offsets, 1);
+        __m256i values = _mm256_add_epi64(_mm256_and_si256(_mm256_srlv_epi64(words, shifts), mask), base);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(&dst[i]), values);
+        bits = _mm256_add_epi64(bits, step);
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] = get(row_idx + i, col_idx);
+    }
+}
+
+size_t PackedStore::packed_bytes() const {
+    size_t n_bytes = 0;
+    for (const auto &col : columns) {
+        n_bytes += sizeof(uint64_t) * (((n_rows + 63) / 64) * col.width + 1);
+    }
+    return n_bytes;
+}